@@ -29,7 +29,7 @@ test -e configure || autoconf
 test -e obj || mkdir obj
 cd obj
 ../configure --enable-autogen --with-jemalloc-prefix=$JE_PREFIX --without-export \
-             --disable-stats --disable-fill \
-             $EXTRA_CONF --with-malloc-conf="narenas:256,lg_tcache_max:12"
+             --disable-fill \
+             $EXTRA_CONF --with-malloc-conf="narenas:256,lg_tcache_max:15"
 
 make -j`nproc`
@@ -33,6 +33,8 @@ noinst_PROGRAMS += examples/hello_memkind \
                    examples/pmem_alignment \
                    examples/pmem_multithreads \
                    examples/pmem_multithreads_onekind \
+                   examples/pmem_multithreads_reserve \
+                   examples/pmem_splice \
                    examples/autohbw_candidates \
                    # end
 if HAVE_CXX11
@@ -50,6 +52,8 @@ examples_pmem_usable_size_LDADD = libmemkind.la
 examples_pmem_alignment_LDADD = libmemkind.la
 examples_pmem_multithreads_LDADD = libmemkind.la
 examples_pmem_multithreads_onekind_LDADD = libmemkind.la
+examples_pmem_multithreads_reserve_LDADD = libmemkind.la
+examples_pmem_splice_LDADD = libmemkind.la
 examples_autohbw_candidates_LDADD = libmemkind.la
 
 if HAVE_CXX11
@@ -67,6 +71,8 @@ examples_pmem_usable_size_SOURCES = examples/pmem_usable_size.c
 examples_pmem_alignment_SOURCES = examples/pmem_alignment.c
 examples_pmem_multithreads_SOURCES = examples/pmem_multithreads.c
 examples_pmem_multithreads_onekind_SOURCES = examples/pmem_multithreads_onekind.c
+examples_pmem_multithreads_reserve_SOURCES = examples/pmem_multithreads_reserve.c
+examples_pmem_splice_SOURCES = examples/pmem_splice.c
 examples_autohbw_candidates_SOURCES = examples/autohbw_candidates.c
 if HAVE_CXX11
 examples_memkind_allocated_SOURCES = examples/memkind_allocated_example.cpp examples/memkind_allocated.hpp
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY LOG OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define PMEM_MAX_SIZE (1024 * 1024 * 1024)
+#define NUM_THREADS 64
+#define NUM_ALLOCS 20000
+#define LIVE_ALLOCS 64
+
+static char* PMEM_DIR = "/tmp/";
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int started = 0;
+
+void *thread_alloc(void *arg);
+static double run_threads(const char *reserve);
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    double time_default, time_reserve;
+
+    if (argc > 2) {
+        fprintf(stderr,"Usage: %s [pmem_kind_dir_path]", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        if (stat(argv[1], &st) != 0 || !S_ISDIR(st.st_mode)) {
+            fprintf(stderr,"%s : Invalid path to pmem kind directory ", argv[1]);
+            return 1;
+        } else {
+            PMEM_DIR = argv[1];
+        }
+    }
+
+    fprintf(stdout,
+            "This example compares allocation throughput of %d threads using one pmem kind\n"
+            "with one mapping per extent and with a single mapping reserved up front.\n"
+            "PMEM kind directory: %s\n", NUM_THREADS, PMEM_DIR);
+
+    time_default = run_threads("0");
+    if (time_default < 0) {
+        return 1;
+    }
+    fprintf(stdout, "mapping per extent: %.0f allocations/s\n",
+            NUM_THREADS * NUM_ALLOCS / time_default);
+
+    /* MEMKIND_PMEM_RESERVE is checked when pmem kind is created */
+    time_reserve = run_threads("1");
+    if (time_reserve < 0) {
+        return 1;
+    }
+    fprintf(stdout, "reserved mapping: %.0f allocations/s\n",
+            NUM_THREADS * NUM_ALLOCS / time_reserve);
+
+    return 0;
+}
+
+static double run_threads(const char *reserve)
+{
+    struct memkind *pmem_kind = NULL;
+    pthread_t pmem_threads[NUM_THREADS];
+    struct timeval start, stop;
+    int err = 0;
+    int t;
+
+    setenv("MEMKIND_PMEM_RESERVE", reserve, 1);
+    err = memkind_create_pmem(PMEM_DIR, PMEM_MAX_SIZE, &pmem_kind);
+    unsetenv("MEMKIND_PMEM_RESERVE");
+    if (err) {
+        perror("memkind_create_pmem()");
+        fprintf(stderr, "Unable to create pmem partition\n");
+        return -1;
+    }
+
+    started = 0;
+    for (t = 0; t < NUM_THREADS; t++) {
+        err = pthread_create(&pmem_threads[t], NULL, thread_alloc, pmem_kind);
+        if (err) {
+            fprintf(stderr, "Unable to create a thread\n");
+            return -1;
+        }
+    }
+
+    /* start all threads at once */
+    gettimeofday(&start, NULL);
+    pthread_mutex_lock(&mutex);
+    started = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    for (t = 0; t < NUM_THREADS; t++) {
+        err = pthread_join(pmem_threads[t], NULL);
+        if (err) {
+            fprintf(stderr, "Thread join failed\n");
+            return -1;
+        }
+    }
+    gettimeofday(&stop, NULL);
+
+    err = memkind_destroy_kind(pmem_kind);
+    if (err) {
+        perror("memkind_destroy_kind()");
+        fprintf(stderr, "Unable to destroy pmem partition\n");
+        return -1;
+    }
+
+    return (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1e6;
+}
+
+void *thread_alloc(void *arg)
+{
+    struct memkind *pmem_kind = (struct memkind *)arg;
+    void *live[LIVE_ALLOCS] = {NULL};
+    unsigned seed = (unsigned)pthread_self();
+    int i;
+
+    pthread_mutex_lock(&mutex);
+    while (!started) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    /* Keep a few allocations of different size alive and replace them */
+    for (i = 0; i < NUM_ALLOCS; i++) {
+        int slot = i % LIVE_ALLOCS;
+        size_t size = 64 << (rand_r(&seed) % 12);
+
+        memkind_free(pmem_kind, live[slot]);
+        live[slot] = memkind_malloc(pmem_kind, size);
+        if (live[slot] == NULL) {
+            perror("thread memkind_malloc()");
+            fprintf(stderr, "Unable to allocate pmem memory\n");
+            break;
+        }
+        *(char *)live[slot] = 'a';
+    }
+
+    for (i = 0; i < LIVE_ALLOCS; i++) {
+        memkind_free(pmem_kind, live[i]);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY LOG OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define OBJECT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 64
+/* default capacity of a pipe, write() would block on larger chunks */
+#define CHUNK_SIZE (64 * 1024)
+
+static char *PMEM_DIR = "/tmp/";
+
+static double get_time(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Moves len bytes from the pipe to /dev/null, like a socket consumer would.
+ */
+static int drain_pipe(int pipe_out, int null_fd, size_t len)
+{
+    while (len > 0) {
+        ssize_t moved = splice(pipe_out, NULL, null_fd, NULL, len, SPLICE_F_MOVE);
+        if (moved <= 0) {
+            return -1;
+        }
+        len -= moved;
+    }
+    return 0;
+}
+
+/*
+ * Streams object to the pipe with splice() straight from the file backing
+ * the pmem kind, without copying it through user space.
+ */
+static int stream_splice(memkind_t kind, const char *object, int pipe_fds[2],
+                         int null_fd)
+{
+    size_t left = OBJECT_SIZE;
+    int fd;
+    off_t offset;
+
+    int err = memkind_pmem_get_fd_offset(kind, object, &fd, &offset);
+    if (err) {
+        return err;
+    }
+
+    while (left > 0) {
+        ssize_t moved = splice(fd, &offset, pipe_fds[1], NULL,
+                               left < CHUNK_SIZE ? left : CHUNK_SIZE, SPLICE_F_MOVE);
+        if (moved <= 0 || drain_pipe(pipe_fds[0], null_fd, moved) != 0) {
+            return -1;
+        }
+        left -= moved;
+    }
+    return 0;
+}
+
+/*
+ * Streams object to the pipe with write(), which copies it to the kernel.
+ */
+static int stream_write(const char *object, int pipe_fds[2], int null_fd)
+{
+    size_t done = 0;
+
+    while (done < OBJECT_SIZE) {
+        size_t len = OBJECT_SIZE - done < CHUNK_SIZE ? OBJECT_SIZE - done : CHUNK_SIZE;
+        ssize_t written = write(pipe_fds[1], object + done, len);
+        if (written <= 0 || drain_pipe(pipe_fds[0], null_fd, written) != 0) {
+            return -1;
+        }
+        done += written;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct memkind *pmem_kind = NULL;
+    struct stat st;
+    int pipe_fds[2];
+    int null_fd;
+    int i, err;
+    double start, time_splice, time_write;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [pmem_kind_dir_path]", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        if (stat(argv[1], &st) != 0 || !S_ISDIR(st.st_mode)) {
+            fprintf(stderr, "%s : Invalid path to pmem kind directory ", argv[1]);
+            return 1;
+        } else {
+            PMEM_DIR = argv[1];
+        }
+    }
+
+    fprintf(stdout,
+            "This example streams an object allocated from pmem kind to a pipe\n"
+            "with splice() from the backing file and with write().\n"
+            "PMEM kind directory: %s\n", PMEM_DIR);
+
+    err = memkind_create_pmem(PMEM_DIR, 0, &pmem_kind);
+    if (err) {
+        perror("memkind_create_pmem()");
+        fprintf(stderr, "Unable to create pmem partition\n");
+        return errno ? -errno : 1;
+    }
+
+    char *object = memkind_malloc(pmem_kind, OBJECT_SIZE);
+    if (object == NULL) {
+        perror("memkind_malloc()");
+        fprintf(stderr, "Unable to allocate pmem object\n");
+        return errno ? -errno : 1;
+    }
+    memset(object, 'o', OBJECT_SIZE);
+
+    /* object must be contiguous in the file to be streamed in one go */
+    int fd;
+    off_t first, last;
+    if (memkind_pmem_get_fd_offset(pmem_kind, object, &fd, &first) ||
+        memkind_pmem_get_fd_offset(pmem_kind, object + OBJECT_SIZE - 1, &fd,
+                                   &last) ||
+        last - first != OBJECT_SIZE - 1) {
+        fprintf(stderr, "Object is not contiguous in the file\n");
+        return 1;
+    }
+
+    null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0 || pipe(pipe_fds) != 0) {
+        perror("open()/pipe()");
+        return errno ? -errno : 1;
+    }
+
+    start = get_time();
+    for (i = 0; i < ITERATIONS; ++i) {
+        if (stream_splice(pmem_kind, object, pipe_fds, null_fd) != 0) {
+            perror("splice()");
+            return 1;
+        }
+    }
+    time_splice = get_time() - start;
+
+    start = get_time();
+    for (i = 0; i < ITERATIONS; ++i) {
+        if (stream_write(object, pipe_fds, null_fd) != 0) {
+            perror("write()");
+            return 1;
+        }
+    }
+    time_write = get_time() - start;
+
+    fprintf(stdout, "splice(): %.0f MB/s\n",
+            ITERATIONS * (OBJECT_SIZE / (1024.0 * 1024.0)) / time_splice);
+    fprintf(stdout, "write():  %.0f MB/s\n",
+            ITERATIONS * (OBJECT_SIZE / (1024.0 * 1024.0)) / time_write);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(null_fd);
+    memkind_free(pmem_kind, object);
+
+    err = memkind_destroy_kind(pmem_kind);
+    if (err) {
+        perror("memkind_destroy_kind()");
+        fprintf(stderr, "Unable to destroy pmem partition\n");
+        return errno ? -errno : 1;
+    }
+
+    fprintf(stdout, "Object has been successfully streamed.\n");
+
+    return 0;
+}
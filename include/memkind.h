@@ -53,7 +53,18 @@ typedef enum memkind_memtype_t {
      * There must be at least two memories with different bandwidth to
      * determine the HBM.
      */
-    MEMKIND_MEMTYPE_HIGH_BANDWIDTH = _MEMKIND_BIT(1)
+    MEMKIND_MEMTYPE_HIGH_BANDWIDTH = _MEMKIND_BIT(1),
+
+    /**
+     * Select memory with the lowest access latency, as reported by the
+     * platform in HMAT or memory local to CPUs if latency is not reported.
+     */
+    MEMKIND_MEMTYPE_LOWEST_LATENCY = _MEMKIND_BIT(2),
+
+    /**
+     * Select memory of NUMA nodes with the highest capacity.
+     */
+    MEMKIND_MEMTYPE_HIGHEST_CAPACITY = _MEMKIND_BIT(3)
 
 } memkind_memtype_t;
 
@@ -114,6 +125,42 @@ typedef enum memkind_bits_t {
     MEMKIND_MASK_PAGE_SIZE_2MB = 21ull,  /**<  Allocations backed by 2 MB page size (2^21 = 2MB) */
 } memkind_bits_t;
 
+/// \brief Arena selection strategy of kinds with many arenas
+/// \warning EXPERIMENTAL API
+typedef enum memkind_arena_select_t {
+    MEMKIND_ARENA_SELECT_HASH = 0,        /**<  Arena chosen by hash of thread identifier (default) */
+    MEMKIND_ARENA_SELECT_CPU = 1,         /**<  Arena of the CPU the thread currently runs on */
+    MEMKIND_ARENA_SELECT_ROUND_ROBIN = 2, /**<  Arenas handed out in turn to threads on their first allocation */
+    MEMKIND_ARENA_SELECT_NODE = 3,        /**<  Arena of the NUMA node the thread currently runs on, chosen by hash of thread identifier among arenas of the node (default for HBW kinds) */
+} memkind_arena_select_t;
+
+/// \brief Policy of returning unused pages of arenas to the OS
+/// \warning EXPERIMENTAL API
+typedef enum memkind_purge_t {
+    MEMKIND_PURGE_LAZY = 0,   /**<  Pages freed lazily with MADV_FREE, then with MADV_DONTNEED after muzzy decay (default) */
+    MEMKIND_PURGE_FORCED = 1, /**<  Pages freed with MADV_DONTNEED only */
+} memkind_purge_t;
+
+/// \brief Counters of address space regions of a kind
+/// \warning EXPERIMENTAL API
+typedef struct memkind_region_stats_t {
+    size_t regions;        /**<  Regions of address space reserved */
+    size_t extents;        /**<  Extents carved out of regions */
+    size_t syscalls_saved; /**<  mmap, mbind and madvise calls saved, net of the cost of regions */
+} memkind_region_stats_t;
+
+/// \brief Statistics of a kind
+/// \warning EXPERIMENTAL API
+typedef struct memkind_stats_t {
+    size_t allocated; /**<  Bytes allocated by the application */
+    size_t active;    /**<  Bytes in active pages of arenas, a multiple of page size */
+    size_t resident;  /**<  Bytes in physically resident pages mapped by arenas */
+    size_t mapped;    /**<  Bytes in extents mapped by arenas */
+    size_t retained;  /**<  Bytes of address space kept for reuse instead of being unmapped */
+    size_t nmalloc;   /**<  Number of allocations */
+    size_t nfree;     /**<  Number of deallocations */
+} memkind_stats_t;
+
 /// \brief Memkind type definition
 /// \warning EXPERIMENTAL API
 typedef struct memkind* memkind_t;
@@ -149,12 +196,16 @@ enum {
 ///
 /// \brief Create kind that allocates memory with specific memory type, memory binding policy and flags.
 /// \warning EXPERIMENTAL API
-/// \note Currently implemented memory type and policy configurations:
+/// \note Configurations served by static kinds:
 ///.      {MEMKIND_MEMTYPE_DEFAULT, MEMKIND_POLICY_PREFERRED_LOCAL},
 ///.      {MEMKIND_MEMTYPE_HIGH_BANDWIDTH, MEMKIND_POLICY_BIND_LOCAL},
 ///       {MEMKIND_MEMTYPE_HIGH_BANDWIDTH, MEMKIND_POLICY_PREFERRED_LOCAL},
 ///       {MEMKIND_MEMTYPE_HIGH_BANDWIDTH, MEMKIND_POLICY_INTERLEAVE_ALL},
-///       {MEMKIND_MEMTYPE_DEFAULT | MEMKIND_MEMTYPE_HIGH_BANDWIDTH, MEMKIND_POLICY_INTERLEAVE_ALL}.
+///       {MEMKIND_MEMTYPE_DEFAULT | MEMKIND_MEMTYPE_HIGH_BANDWIDTH, MEMKIND_POLICY_INTERLEAVE_ALL},
+///       {MEMKIND_MEMTYPE_LOWEST_LATENCY, MEMKIND_POLICY_BIND_LOCAL},
+///       {MEMKIND_MEMTYPE_HIGHEST_CAPACITY, MEMKIND_POLICY_BIND_LOCAL}.
+///       Other configurations create a kind on the first call and return the
+///       same kind on later calls with the same arguments.
 /// \param memtype_flags determine the memory types to allocate from by combination of memkind_memtype_t values.
 ///        This field cannot have zero value.
 /// \param policy specify policy for page binding to memory types selected by  memtype_flags.
@@ -171,7 +222,9 @@ int memkind_create_kind(memkind_memtype_t memtype_flags,
 
 ///
 /// \brief Destroy the kind object. The kind object needs to be initialized by
-///        memkind_create_kind() or memkind_create_pmem() before it is destroyed.
+///        memkind_create_pmem() before it is destroyed. Static kinds and kinds
+///        returned by memkind_create_kind() are shared and kept until the
+///        library is unloaded, for them the function does nothing.
 ///        The function has undefined behavior when the handle is invalid.
 /// \warning EXPERIMENTAL API
 /// \note all allocated memory must be freed before kind is destroyed, otherwise
@@ -217,6 +270,21 @@ extern memkind_t MEMKIND_HBW_INTERLEAVE;
 /// \warning EXPERIMENTAL API
 extern memkind_t MEMKIND_INTERLEAVE;
 
+/// \warning EXPERIMENTAL API
+extern memkind_t MEMKIND_LOWEST_LATENCY;
+
+/// \warning EXPERIMENTAL API
+extern memkind_t MEMKIND_HIGHEST_CAPACITY;
+
+/// \warning EXPERIMENTAL API
+extern memkind_t MEMKIND_DAX_KMEM;
+
+/// \warning EXPERIMENTAL API
+extern memkind_t MEMKIND_DAX_KMEM_ALL;
+
+/// \warning EXPERIMENTAL API
+extern memkind_t MEMKIND_DAX_KMEM_PREFERRED;
+
 ///
 /// \brief Get Memkind API version
 /// \note STANDARD API
@@ -245,6 +313,255 @@ void memkind_error_message(int err, char *msg, size_t size);
 ///
 int memkind_create_pmem(const char *dir, size_t max_size, memkind_t *kind);
 
+/// \brief Options of PMEM kind, options which are not set are taken from the environment
+/// \warning EXPERIMENTAL API
+struct memkind_config;
+
+///
+/// \brief Create a memkind configuration with all options not set
+/// \warning EXPERIMENTAL API
+/// \return Pointer to the configuration, NULL on failure
+///
+struct memkind_config *memkind_config_new(void);
+
+///
+/// \brief Delete a memkind configuration
+/// \warning EXPERIMENTAL API
+/// \param cfg configuration created by memkind_config_new()
+///
+void memkind_config_delete(struct memkind_config *cfg);
+
+///
+/// \brief Set directory of the temporary file of PMEM kind
+/// \warning EXPERIMENTAL API
+/// \param cfg memkind configuration
+/// \param pmem_dir path to directory, it must stay valid until the kind is created
+///
+void memkind_config_set_path(struct memkind_config *cfg, const char *pmem_dir);
+
+///
+/// \brief Set size limit of PMEM kind
+/// \warning EXPERIMENTAL API
+/// \param cfg memkind configuration
+/// \param pmem_size size limit for kind, 0 for unlimited size
+///
+void memkind_config_set_size(struct memkind_config *cfg, size_t pmem_size);
+
+///
+/// \brief Set whether PMEM kind maps its whole size at once, overrides MEMKIND_PMEM_RESERVE
+/// \warning EXPERIMENTAL API
+/// \param cfg memkind configuration
+/// \param reserve non-zero to map the whole size of the kind at once
+///
+void memkind_config_set_pmem_reserve(struct memkind_config *cfg, int reserve);
+
+///
+/// \brief Set number of arenas of PMEM kind, overrides MEMKIND_PMEM_ARENA_NUM_PER_KIND
+/// \warning EXPERIMENTAL API
+/// \param cfg memkind configuration
+/// \param arena_num number of arenas (not greater than INT_MAX), rounded up to a power of two
+///
+void memkind_config_set_arena_num(struct memkind_config *cfg, unsigned arena_num);
+
+///
+/// \brief Create a new PMEM (file-backed) kind with the options of configuration
+/// \warning EXPERIMENTAL API
+/// \param cfg memkind configuration
+/// \param kind pointer to kind which will be created
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_create_pmem_with_config(struct memkind_config *cfg, memkind_t *kind);
+
+///
+/// \brief Create a new PMEM (file-backed) kind of given size striped across temporary files
+///        in the given directories dirs, extents of the kind are mapped from the files in turn
+/// \warning EXPERIMENTAL API
+/// \param dirs paths to directories of temporary files, usually on different devices
+/// \param num number of directories
+/// \param max_size size limit for kind, split equally between the files
+/// \param kind pointer to kind which will be created
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_create_pmem_multi(const char *const *dirs, size_t num,
+                              size_t max_size, memkind_t *kind);
+
+///
+/// \brief Open a persistent PMEM (file-backed) kind of given size on top of the file path,
+///        the file is created when it does not exist
+/// \warning EXPERIMENTAL API
+/// \param path path to the file of the kind
+/// \param max_size size limit for kind, must match the size used when the file was created
+/// \param kind pointer to kind which will be created
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_open_pmem(const char *path, size_t max_size, memkind_t *kind);
+
+///
+/// \brief Get root object of persistent PMEM kind
+/// \warning EXPERIMENTAL API
+/// \param kind kind opened with memkind_open_pmem()
+/// \param root pointer to the root object, NULL when it was not set
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_get_root(memkind_t kind, void **root);
+
+///
+/// \brief Set root object of persistent PMEM kind
+/// \warning EXPERIMENTAL API
+/// \param kind kind opened with memkind_open_pmem()
+/// \param root pointer to the root object allocated from kind, or NULL
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_set_root(memkind_t kind, void *root);
+
+///
+/// \brief Free object allocated from persistent PMEM kind before it was opened,
+///        which is not known to the heap manager
+/// \warning EXPERIMENTAL API
+/// \param kind kind opened with memkind_open_pmem()
+/// \param ptr pointer to the object
+/// \param size size of the object
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_free_recovered(memkind_t kind, void *ptr, size_t size);
+
+///
+/// \brief Make stores to memory of PMEM kind durable, equivalent of memkind_pmem_flush()
+///        followed by memkind_pmem_drain()
+/// \warning EXPERIMENTAL API
+/// \param kind PMEM kind
+/// \param ptr pointer to the memory allocated from kind
+/// \param len length of the memory
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_persist(memkind_t kind, const void *ptr, size_t len);
+
+///
+/// \brief Flush CPU caches (on DAX) or page cache for memory of PMEM kind
+/// \warning EXPERIMENTAL API
+/// \param kind PMEM kind
+/// \param ptr pointer to the memory allocated from kind
+/// \param len length of the memory
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_flush(memkind_t kind, const void *ptr, size_t len);
+
+///
+/// \brief Wait for flushes of memory of PMEM kind started by memkind_pmem_flush()
+/// \warning EXPERIMENTAL API
+/// \param kind PMEM kind
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, other values on failure
+///
+int memkind_pmem_drain(memkind_t kind);
+
+///
+/// \brief Get file descriptor and offset in the file backing memory of PMEM kind at ptr,
+///        e.g. to pass it to sendfile(), splice() or copy_file_range()
+/// \warning EXPERIMENTAL API
+/// \param kind PMEM kind
+/// \param ptr pointer to the memory allocated from kind
+/// \param fd file descriptor of the file, owned by the kind
+/// \param offset offset of ptr in the file
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         when ptr is not memory of kind
+///
+int memkind_pmem_get_fd_offset(memkind_t kind, const void *ptr, int *fd,
+                               off_t *offset);
+
+///
+/// \brief Set the largest allocation size of kind served from per-thread caches
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be based on jemalloc arenas
+/// \param max_size max allocation size in bytes, at most 32KB, 0 disables thread caches
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_set_tcache_max(memkind_t kind, size_t max_size);
+
+///
+/// \brief Set the strategy which picks an arena of kind for the calling thread
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must have an arena per thread group
+/// \param select arena selection strategy
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_set_arena_select(memkind_t kind, memkind_arena_select_t select);
+
+///
+/// \brief Set limits of the cache of address space released by arenas of kind
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be backed by anonymous memory
+/// \param max_size max size in bytes of the released address space kept for reuse
+/// \param decay_ms time in milliseconds after which released address space is unmapped
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_set_extent_cache(memkind_t kind, size_t max_size,
+                             unsigned decay_ms);
+
+///
+/// \brief Get counters of address space regions extents of kind are carved out of
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be backed by anonymous memory of regular pages
+/// \param stats counters of kind
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_get_region_stats(memkind_t kind, memkind_region_stats_t *stats);
+
+///
+/// \brief Get statistics of kind
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be based on jemalloc arenas
+/// \param stats statistics of kind
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_get_stats(memkind_t kind, memkind_stats_t *stats);
+
+///
+/// \brief Print statistics of all kinds based on jemalloc arenas in JSON format
+/// \warning EXPERIMENTAL API
+/// \param write_cb callback writing the output, NULL writes to stderr
+/// \param cbopaque argument passed to write_cb
+///
+void memkind_stats_print(void (*write_cb)(void *, const char *),
+                         void *cbopaque);
+
+///
+/// \brief Set decay times after which unused pages of arenas of kind are purged
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be based on jemalloc arenas
+/// \param dirty_decay_ms time in milliseconds after which unused dirty pages are purged,
+///        0 purges them at once, -1 never
+/// \param muzzy_decay_ms time in milliseconds after which lazily purged pages are purged
+///        for good, 0 purges them at once, -1 never
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_set_decay(memkind_t kind, ssize_t dirty_decay_ms,
+                      ssize_t muzzy_decay_ms);
+
+///
+/// \brief Start, reconfigure or stop the background thread purging arenas of all kinds
+/// \warning EXPERIMENTAL API
+/// \param interval_ms time in milliseconds between runs of the thread, 0 stops the thread
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_RUNTIME
+///         when the thread cannot be created
+///
+int memkind_set_background_purge(unsigned interval_ms);
+
+///
+/// \brief Set the policy of returning unused pages of arenas of kind to the OS
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind, must be based on jemalloc arenas
+/// \param purge purge policy
+/// \return Memkind operation status, MEMKIND_SUCCESS on success, MEMKIND_ERROR_INVALID
+///         on failure
+///
+int memkind_set_purge(memkind_t kind, memkind_purge_t purge);
+
 ///
 /// \brief Check if kind is available
 /// \warning EXPERIMENTAL API
@@ -273,6 +590,16 @@ void *memkind_malloc(memkind_t kind, size_t size);
 ///
 size_t memkind_malloc_usable_size(memkind_t kind, void *ptr);
 
+///
+/// \brief Obtain size of block of memory which would be allocated for a request of size bytes
+/// \warning EXPERIMENTAL API
+/// \param kind specified memory kind
+/// \param size number of bytes to allocate
+/// \return Number of usable bytes of such allocation, size itself if kind does not expose
+///         its size classes, 0 if size cannot be allocated
+///
+size_t memkind_good_size(memkind_t kind, size_t size);
+
 ///
 /// \brief Allocates memory of the specified kind for an array of num elements
 ///        of size bytes each and initializes all bytes in the allocated storage to zero
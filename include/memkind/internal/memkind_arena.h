@@ -61,6 +61,11 @@ int memkind_thread_get_arena(struct memkind *kind, unsigned int *arena,
 int memkind_arena_finalize(struct memkind *kind);
 void memkind_arena_init(struct memkind *kind);
 void memkind_arena_free(struct memkind *kind, void* ptr);
+void *memkind_arena_malloc_uncounted(struct memkind *kind, size_t size);
+void memkind_arena_free_uncounted(struct memkind *kind, void *ptr);
+int memkind_arena_purge(struct memkind *kind);
+int memkind_arena_stats(struct memkind *kind, memkind_stats_t *stats);
+int memkind_arena_extent_node(void);
 
 #ifdef __cplusplus
 }
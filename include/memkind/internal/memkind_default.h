@@ -63,6 +63,7 @@ int memkind_nohugepage_madvise(struct memkind *kind, void *addr, size_t size);
 int memkind_posix_check_alignment(struct memkind *kind, size_t alignment);
 void memkind_default_init_once(void);
 size_t memkind_default_malloc_usable_size(struct memkind *kind, void *ptr);
+size_t memkind_default_good_size(struct memkind *kind, size_t size);
 
 static inline bool size_out_of_bounds(size_t size)
 {
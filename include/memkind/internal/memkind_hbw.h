@@ -33,6 +33,9 @@ extern "C" {
 
 #include <memkind.h>
 
+#include <numa.h>
+#include <stdbool.h>
+
 /*
  * Header file for the high bandwidth memory memkind operations.
  * More details in memkind_hbw(3) man page.
@@ -49,6 +52,31 @@ int memkind_hbw_get_mbind_nodemask(struct memkind *kind,
 int memkind_hbw_all_get_mbind_nodemask(struct memkind *kind,
                                        unsigned long *nodemask,
                                        unsigned long maxnode);
+
+// Fills values of NUMA nodes, higher is better and 0 marks unknown nodes.
+typedef int (*memkind_fill_values_t)(int *values, int values_len);
+
+// Maps every CPU to the closest NUMA node of those with the highest value.
+struct memkind_closest_numanode_t {
+    int init_err;
+    int num_cpu;
+    int *closest_numanode;
+    int num_node;
+    int *closest_numanode_of_node; // -1 for nodes without CPUs
+    // all equally close nodes of CPUs of a node, NULL unless ties are allowed
+    nodemask_t *closest_nodemask_of_node;
+};
+
+void memkind_closest_numanode_init(struct memkind_closest_numanode_t *g,
+                                   memkind_fill_values_t fill_values,
+                                   const char *memory_name, bool allow_ties);
+int memkind_closest_numanode_get_mbind_nodemask(
+    const struct memkind_closest_numanode_t *g, unsigned long *nodemask,
+    unsigned long maxnode);
+int memkind_closest_numanode_all_get_mbind_nodemask(
+    const struct memkind_closest_numanode_t *g, unsigned long *nodemask,
+    unsigned long maxnode);
+
 void memkind_hbw_init_once(void);
 void memkind_hbw_all_init_once(void);
 void memkind_hbw_hugetlb_init_once(void);
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MEMKIND_INTERNAL_API
+#warning "DO NOT INCLUDE THIS FILE! IT IS INTERNAL MEMKIND API AND SOON WILL BE REMOVED FROM BIN & DEVEL PACKAGES"
+#endif
+
+#include <memkind.h>
+
+#include <stdbool.h>
+
+/*
+ * Header file for detection of memory tiers from performance attributes of
+ * NUMA nodes, which the kernel exports to sysfs from the ACPI HMAT, and for
+ * the lowest latency and highest capacity memkind operations.
+ *
+ * Functionality defined in this header is considered as EXPERIMENTAL API.
+ * API standards are described in memkind(3) man page.
+ */
+
+typedef enum memkind_hmat_attr_t {
+    MEMKIND_HMAT_READ_BANDWIDTH = 0, // MB/s
+    MEMKIND_HMAT_WRITE_BANDWIDTH,    // MB/s
+    MEMKIND_HMAT_READ_LATENCY,       // ns
+    MEMKIND_HMAT_WRITE_LATENCY,      // ns
+    MEMKIND_HMAT_ATTR_MAX
+} memkind_hmat_attr_t;
+
+// Root of sysfs, "/sys" unless overridden by MEMKIND_SYSFS_ROOT.
+const char *memkind_sysfs_root(void);
+// Returns true if node exists and false otherwise.
+bool memkind_sysfs_node_exists(int node);
+// Returns true if node has CPUs and false otherwise.
+bool memkind_sysfs_node_has_cpus(int node);
+// Reads attr of node as seen from its local initiators.
+int memkind_hmat_get_attr(int node, memkind_hmat_attr_t attr,
+                          unsigned long *value);
+// Fills bandwidth of nodes in MB/s; nodes in the top tier get equal values.
+int memkind_hmat_fill_bandwidth(int *bandwidth, int bandwidth_len);
+// Reads total memory of node in bytes.
+int memkind_sysfs_node_capacity(int node, unsigned long long *capacity);
+// Ranks nodes by latency for memkind_closest_numanode_init().
+int memkind_hmat_fill_lowest_latency(int *values, int values_len);
+// Ranks nodes by capacity for memkind_closest_numanode_init().
+int memkind_sysfs_fill_highest_capacity(int *values, int values_len);
+
+int memkind_lowest_latency_get_mbind_nodemask(struct memkind *kind,
+                                              unsigned long *nodemask,
+                                              unsigned long maxnode);
+int memkind_lowest_latency_all_get_mbind_nodemask(struct memkind *kind,
+                                                  unsigned long *nodemask,
+                                                  unsigned long maxnode);
+int memkind_highest_capacity_get_mbind_nodemask(struct memkind *kind,
+                                                unsigned long *nodemask,
+                                                unsigned long maxnode);
+int memkind_highest_capacity_all_get_mbind_nodemask(struct memkind *kind,
+                                                    unsigned long *nodemask,
+                                                    unsigned long maxnode);
+
+extern struct memkind_ops MEMKIND_LOWEST_LATENCY_OPS;
+extern struct memkind_ops MEMKIND_HIGHEST_CAPACITY_OPS;
+
+#ifdef __cplusplus
+}
+#endif
@@ -36,6 +36,7 @@ extern "C" {
 #include "memkind_arena.h"
 
 #include <pthread.h>
+#include <stdint.h>
 
 /*
  * Header file for the file-backed memory memkind operations.
@@ -46,18 +47,107 @@ extern "C" {
  */
 
 #define MEMKIND_PMEM_CHUNK_SIZE (1ull << 21ull) // 2MB
+#define MEMKIND_PMEM_SIGNATURE "MEMKIND_PMEM"
+#define MEMKIND_PMEM_HEADER_VERSION 2
 
 int memkind_pmem_create(struct memkind *kind, struct memkind_ops *ops,
                         const char *name);
 int memkind_pmem_destroy(struct memkind *kind);
 void *memkind_pmem_mmap(struct memkind *kind, void *addr, size_t size);
+int memkind_pmem_munmap(struct memkind *kind, void *addr, size_t size);
 int memkind_pmem_get_mmap_flags(struct memkind *kind, int *flags);
+int memkind_pmem_reserve(struct memkind *kind);
+int memkind_pmem_open(struct memkind *kind);
+int memkind_pmem_create_stripes(struct memkind *kind, const int *fds,
+                                size_t num);
+int memkind_pmem_prefault(struct memkind *kind, size_t watermark);
+void memkind_pmem_free(struct memkind *kind, void *ptr);
+void *memkind_pmem_realloc(struct memkind *kind, void *ptr, size_t size);
+size_t memkind_pmem_malloc_usable_size(struct memkind *kind, void *ptr);
+// Returns true when ptr was allocated from kind before it was opened.
+bool memkind_pmem_is_recovered(struct memkind *kind, const void *ptr);
+// Returns number of open kinds which hold objects allocated before.
+unsigned memkind_pmem_recovered_kinds(void);
+
+enum memkind_pmem_flush_type {
+    MEMKIND_PMEM_FLUSH_AUTO = 0, // chosen when the kind is flushed first time
+    MEMKIND_PMEM_FLUSH_MSYNC,
+    MEMKIND_PMEM_FLUSH_CLFLUSH,
+    MEMKIND_PMEM_FLUSH_CLFLUSHOPT,
+    MEMKIND_PMEM_FLUSH_CLWB
+};
+
+bool memkind_pmem_flush_type_available(enum memkind_pmem_flush_type type);
+
+// range of the file space which can be reused by next mmap
+struct memkind_pmem_range {
+    off_t offset;
+    size_t size;
+};
+
+// mapped part of the file
+struct memkind_pmem_extent {
+    void *addr;
+    size_t size;
+    off_t offset;
+};
+
+// mapped and faulted memory waiting for the next extent allocation
+struct memkind_pmem_ready {
+    void *addr;
+    size_t size;
+    bool zeroed;
+};
+
+// state of the thread which maps and faults memory in advance
+struct memkind_pmem_prefault {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t watermark; // size of memory kept ready
+    size_t piece; // size of memory mapped at once
+    size_t ready_size;
+    bool full; // kind has no space left, thread waits until memory is taken
+    bool stop;
+    struct memkind_pmem_ready *ready;
+    size_t ready_num;
+    size_t ready_cap;
+};
+
+// placed at the beginning of the file of persistent kind
+struct memkind_pmem_header {
+    char signature[16];
+    uint64_t version;
+    uint64_t size; // max_size of the kind
+    uint64_t addr; // address the file is mapped at
+    uint64_t offset; // end of used file space
+    uint64_t root; // offset of the root object, 0 when not set
+    uint64_t free_map; // offset of bitmap of pages, bit is set when page is free
+};
 
 struct memkind_pmem {
     int fd;
-    off_t offset;
+    off_t offset; // end of used file space
     size_t max_size;
+    size_t alignment; // of file offsets and addresses of mapped extents
+    void *addr; // whole file mapped up front (MEMKIND_PMEM_RESERVE), or NULL
+    struct memkind_pmem_header *header; // NULL for temporary file
+    off_t recovered; // end of file space used before the kind was opened
+    uint64_t *recovered_map; // bitmap of pages used before the kind was opened
+    bool closing; // persistent kind is being destroyed, its data must be kept
+    int mmap_flags; // MAP_SHARED, or MAP_SHARED_VALIDATE | MAP_SYNC on DAX, 0 until checked
+    enum memkind_pmem_flush_type flush_type;
     pthread_mutex_t pmem_lock;
+    struct memkind_pmem_range *free_ranges; // sorted by offset
+    size_t free_ranges_num;
+    size_t free_ranges_cap;
+    struct memkind_pmem_extent *extents; // sorted by addr
+    size_t extents_num;
+    size_t extents_cap;
+    struct memkind_pmem *stripes; // one per file of kind striped across directories, or NULL
+    size_t stripes_num;
+    size_t next_stripe; // file which maps next extent
+    struct memkind_pmem_prefault *prefault; // NULL when memory is not prepared in advance
 };
 
 extern struct memkind_ops MEMKIND_PMEM_OPS;
@@ -34,6 +34,7 @@ extern "C" {
 #include "memkind.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #ifdef __GNUC__
@@ -71,6 +72,22 @@ extern "C" {
 #define jemk_free                   JE_SYMBOL(free)
 #define jemk_dallocx                JE_SYMBOL(dallocx)
 #define jemk_malloc_usable_size     JE_SYMBOL(malloc_usable_size)
+#define jemk_nallocx                JE_SYMBOL(nallocx)
+
+typedef struct registers_t {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+} registers_t;
+
+inline static void cpuid_asm(int leaf, int subleaf, registers_t* registers)
+{
+    asm volatile("cpuid":"=a"(registers->eax),
+                 "=b"(registers->ebx),
+                 "=c"(registers->ecx),
+                 "=d"(registers->edx):"0"(leaf), "2"(subleaf));
+}
 
 enum memkind_const_private {
     MEMKIND_NAME_LENGTH_PRIV = 64
@@ -98,6 +115,15 @@ struct memkind_ops {
     void (* init_once)(void);
     int (* finalize)(struct memkind *kind);
     size_t (* malloc_usable_size)(struct memkind *kind, void *addr);
+    size_t (* good_size)(struct memkind *kind, size_t size);
+};
+
+// options of the pmem kind created by memkind_create_pmem_with_config()
+struct memkind_config {
+    const char *pmem_dir;
+    size_t pmem_size;
+    int pmem_reserve; // -1 when not set, MEMKIND_PMEM_RESERVE decides
+    unsigned arena_num; // 0 when not set, MEMKIND_PMEM_ARENA_NUM_PER_KIND decides
 };
 
 struct memkind {
@@ -106,12 +132,20 @@ struct memkind {
     char name[MEMKIND_NAME_LENGTH_PRIV];
     pthread_once_t init_once;
     unsigned int arena_map_len; // is power of 2
-    unsigned int *arena_map; // To be deleted beyond 1.2.0+
+    unsigned int *arena_map; // jemalloc arena of each slot, 0 until first use
     pthread_key_t arena_key;
     void *priv;
     unsigned int
     arena_map_mask; // arena_map_len - 1 to optimize modulo operation on arena_map_len
     unsigned int arena_zero; // index first jemalloc arena of this kind
+    size_t tcache_max; // max allocation size served from thread cache
+    memkind_arena_select_t arena_select; // used by memkind_thread_get_arena()
+    struct extent_hooks_s *arena_hooks; // extent hooks of arenas created lazily
+    struct memkind_extent_cache *extent_cache; // extents released by arenas
+    struct memkind_region_pool *region_pool; // address space carved into extents
+    ssize_t dirty_decay_ms; // decay time of dirty pages of arenas
+    ssize_t muzzy_decay_ms; // decay time of muzzy pages of arenas
+    memkind_purge_t purge; // how arenas return unused pages to the OS
 };
 
 void memkind_init(memkind_t kind, bool check_numa);
@@ -77,6 +77,11 @@ enum memkind_base_partition {
     MEMKIND_PARTITION_REGULAR = 11,
     MEMKIND_PARTITION_HBW_ALL = 12,
     MEMKIND_PARTITION_HBW_ALL_HUGETLB = 13,
+    MEMKIND_PARTITION_LOWEST_LATENCY = 14,
+    MEMKIND_PARTITION_HIGHEST_CAPACITY = 15,
+    MEMKIND_PARTITION_DAX_KMEM = 16,
+    MEMKIND_PARTITION_DAX_KMEM_ALL = 17,
+    MEMKIND_PARTITION_DAX_KMEM_PREFERRED = 18,
     MEMKIND_NUM_BASE_KIND
 };
 
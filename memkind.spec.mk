@@ -201,6 +201,8 @@ ${memkind_test_dir}/pmem_usable_size
 ${memkind_test_dir}/pmem_alignment
 ${memkind_test_dir}/pmem_multithreads
 ${memkind_test_dir}/pmem_multithreads_onekind
+${memkind_test_dir}/pmem_multithreads_reserve
+${memkind_test_dir}/pmem_splice
 ${memkind_test_dir}/allocator_perf_tool_tests
 ${memkind_test_dir}/perf_tool
 ${memkind_test_dir}/autohbw_test_helper
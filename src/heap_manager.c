@@ -42,7 +42,7 @@ struct heap_manager_ops {
 
 struct heap_manager_ops arena_heap_manager_g = {
     .init = memkind_arena_init,
-    .heap_manager_free = memkind_default_free
+    .heap_manager_free = memkind_arena_free
 };
 
 struct heap_manager_ops tbb_heap_manager_g = {
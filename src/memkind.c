@@ -30,6 +30,9 @@
 #include <memkind/internal/memkind_hugetlb.h>
 #include <memkind/internal/memkind_arena.h>
 #include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_dax_kmem.h>
+#include <memkind/internal/memkind_memtype.h>
 #include <memkind/internal/memkind_regular.h>
 #include <memkind/internal/memkind_gbtlb.h>
 #include <memkind/internal/memkind_pmem.h>
@@ -45,6 +48,7 @@
 #include <sys/param.h>
 #include <sys/mman.h>
 #include <stdint.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -87,6 +91,7 @@ static struct memkind MEMKIND_INTERLEAVE_STATIC = {
 static struct memkind MEMKIND_HBW_STATIC = {
     .ops = &MEMKIND_HBW_OPS,
     .partition = MEMKIND_PARTITION_HBW,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
     .name = "memkind_hbw",
     .init_once = PTHREAD_ONCE_INIT,
 };
@@ -101,6 +106,7 @@ static struct memkind MEMKIND_HBW_ALL_STATIC = {
 static struct memkind MEMKIND_HBW_PREFERRED_STATIC = {
     .ops = &MEMKIND_HBW_PREFERRED_OPS,
     .partition = MEMKIND_PARTITION_HBW_PREFERRED,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
     .name = "memkind_hbw_preferred",
     .init_once = PTHREAD_ONCE_INIT,
 };
@@ -108,6 +114,7 @@ static struct memkind MEMKIND_HBW_PREFERRED_STATIC = {
 static struct memkind MEMKIND_HBW_HUGETLB_STATIC = {
     .ops = &MEMKIND_HBW_HUGETLB_OPS,
     .partition = MEMKIND_PARTITION_HBW_HUGETLB,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
     .name = "memkind_hbw_hugetlb",
     .init_once = PTHREAD_ONCE_INIT,
 };
@@ -122,6 +129,7 @@ static struct memkind MEMKIND_HBW_ALL_HUGETLB_STATIC = {
 static struct memkind MEMKIND_HBW_PREFERRED_HUGETLB_STATIC = {
     .ops = &MEMKIND_HBW_PREFERRED_HUGETLB_OPS,
     .partition = MEMKIND_PARTITION_HBW_PREFERRED_HUGETLB,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
     .name = "memkind_hbw_preferred_hugetlb",
     .init_once = PTHREAD_ONCE_INIT,
 };
@@ -154,6 +162,45 @@ static struct memkind MEMKIND_HBW_INTERLEAVE_STATIC = {
     .init_once = PTHREAD_ONCE_INIT,
 };
 
+static struct memkind MEMKIND_LOWEST_LATENCY_STATIC = {
+    .ops = &MEMKIND_LOWEST_LATENCY_OPS,
+    .partition = MEMKIND_PARTITION_LOWEST_LATENCY,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
+    .name = "memkind_lowest_latency",
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
+static struct memkind MEMKIND_HIGHEST_CAPACITY_STATIC = {
+    .ops = &MEMKIND_HIGHEST_CAPACITY_OPS,
+    .partition = MEMKIND_PARTITION_HIGHEST_CAPACITY,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
+    .name = "memkind_highest_capacity",
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
+static struct memkind MEMKIND_DAX_KMEM_STATIC = {
+    .ops = &MEMKIND_DAX_KMEM_OPS,
+    .partition = MEMKIND_PARTITION_DAX_KMEM,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
+    .name = "memkind_dax_kmem",
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
+static struct memkind MEMKIND_DAX_KMEM_ALL_STATIC = {
+    .ops = &MEMKIND_DAX_KMEM_ALL_OPS,
+    .partition = MEMKIND_PARTITION_DAX_KMEM_ALL,
+    .name = "memkind_dax_kmem_all",
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
+static struct memkind MEMKIND_DAX_KMEM_PREFERRED_STATIC = {
+    .ops = &MEMKIND_DAX_KMEM_PREFERRED_OPS,
+    .partition = MEMKIND_PARTITION_DAX_KMEM_PREFERRED,
+    .arena_select = MEMKIND_ARENA_SELECT_NODE,
+    .name = "memkind_dax_kmem_preferred",
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
 static struct memkind MEMKIND_REGULAR_STATIC = {
     .ops = &MEMKIND_REGULAR_OPS,
     .partition = MEMKIND_PARTITION_REGULAR,
@@ -181,6 +228,15 @@ MEMKIND_EXPORT struct memkind *MEMKIND_GBTLB = &MEMKIND_GBTLB_STATIC;
 MEMKIND_EXPORT struct memkind *MEMKIND_HBW_INTERLEAVE =
         &MEMKIND_HBW_INTERLEAVE_STATIC;
 MEMKIND_EXPORT struct memkind *MEMKIND_REGULAR = &MEMKIND_REGULAR_STATIC;
+MEMKIND_EXPORT struct memkind *MEMKIND_LOWEST_LATENCY =
+        &MEMKIND_LOWEST_LATENCY_STATIC;
+MEMKIND_EXPORT struct memkind *MEMKIND_HIGHEST_CAPACITY =
+        &MEMKIND_HIGHEST_CAPACITY_STATIC;
+MEMKIND_EXPORT struct memkind *MEMKIND_DAX_KMEM = &MEMKIND_DAX_KMEM_STATIC;
+MEMKIND_EXPORT struct memkind *MEMKIND_DAX_KMEM_ALL =
+        &MEMKIND_DAX_KMEM_ALL_STATIC;
+MEMKIND_EXPORT struct memkind *MEMKIND_DAX_KMEM_PREFERRED =
+        &MEMKIND_DAX_KMEM_PREFERRED_STATIC;
 
 struct memkind_registry {
     struct memkind *partition_map[MEMKIND_MAX_KIND];
@@ -204,6 +260,11 @@ static struct memkind_registry memkind_registry_g = {
         [MEMKIND_PARTITION_REGULAR] = &MEMKIND_REGULAR_STATIC,
         [MEMKIND_PARTITION_HBW_ALL] = &MEMKIND_HBW_ALL_STATIC,
         [MEMKIND_PARTITION_HBW_ALL_HUGETLB] = &MEMKIND_HBW_ALL_HUGETLB_STATIC,
+        [MEMKIND_PARTITION_LOWEST_LATENCY] = &MEMKIND_LOWEST_LATENCY_STATIC,
+        [MEMKIND_PARTITION_HIGHEST_CAPACITY] = &MEMKIND_HIGHEST_CAPACITY_STATIC,
+        [MEMKIND_PARTITION_DAX_KMEM] = &MEMKIND_DAX_KMEM_STATIC,
+        [MEMKIND_PARTITION_DAX_KMEM_ALL] = &MEMKIND_DAX_KMEM_ALL_STATIC,
+        [MEMKIND_PARTITION_DAX_KMEM_PREFERRED] = &MEMKIND_DAX_KMEM_PREFERRED_STATIC,
     },
     MEMKIND_NUM_BASE_KIND,
     PTHREAD_MUTEX_INITIALIZER
@@ -225,6 +286,8 @@ static int validate_memtype_bits(memkind_memtype_t memtype)
 
     CLEAR_BIT(memtype, MEMKIND_MEMTYPE_DEFAULT);
     CLEAR_BIT(memtype, MEMKIND_MEMTYPE_HIGH_BANDWIDTH);
+    CLEAR_BIT(memtype, MEMKIND_MEMTYPE_LOWEST_LATENCY);
+    CLEAR_BIT(memtype, MEMKIND_MEMTYPE_HIGHEST_CAPACITY);
 
     if(memtype != 0) return -1;
     return 0;
@@ -263,8 +326,84 @@ static struct create_args supported_args[] = {
     {&MEMKIND_DEFAULT_STATIC,                MEMKIND_POLICY_PREFERRED_LOCAL, 0,                          MEMKIND_MEMTYPE_DEFAULT},
     {&MEMKIND_HUGETLB_STATIC,                MEMKIND_POLICY_PREFERRED_LOCAL, MEMKIND_MASK_PAGE_SIZE_2MB, MEMKIND_MEMTYPE_DEFAULT},
     {&MEMKIND_INTERLEAVE_STATIC,             MEMKIND_POLICY_INTERLEAVE_ALL,  0,                          MEMKIND_MEMTYPE_HIGH_BANDWIDTH | MEMKIND_MEMTYPE_DEFAULT},
+    {&MEMKIND_LOWEST_LATENCY_STATIC,         MEMKIND_POLICY_BIND_LOCAL,      0,                          MEMKIND_MEMTYPE_LOWEST_LATENCY},
+    {&MEMKIND_HIGHEST_CAPACITY_STATIC,       MEMKIND_POLICY_BIND_LOCAL,      0,                          MEMKIND_MEMTYPE_HIGHEST_CAPACITY},
 };
 
+static int memkind_create(struct memkind_ops *ops, const char *name,
+                          unsigned int arena_num,
+                          memkind_arena_select_t arena_select,
+                          struct memkind **kind);
+
+static int memkind_destroy(memkind_t kind);
+
+#define MEMTYPE_KINDS_MEMTYPES (MEMKIND_MEMTYPE_HIGHEST_CAPACITY << 1)
+
+/*
+ * Kinds composed for combinations without a static kind, created once and
+ * kept until the library is unloaded, indexed by memory types, policy and
+ * page size.
+ */
+static memkind_t memtype_kinds[MEMTYPE_KINDS_MEMTYPES][MEMKIND_POLICY_MAX_VALUE][2];
+static pthread_mutex_t memtype_kinds_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool memkind_is_memtype_kind(memkind_t kind)
+{
+    return kind->ops == &MEMKIND_MEMTYPE_OPS ||
+           kind->ops == &MEMKIND_MEMTYPE_HUGETLB_OPS;
+}
+
+/*
+ * Creates kind for combination of memory types, policy and flags which has
+ * no static kind, see memkind_memtype.c. Kind created by an earlier call for
+ * the same combination is returned again.
+ */
+static int memkind_create_memtype_kind(memkind_memtype_t memtype_flags,
+                                       memkind_policy_t policy,
+                                       memkind_bits_t flags,
+                                       memkind_t *kind)
+{
+    char name[MEMKIND_NAME_LENGTH_PRIV];
+    memkind_arena_select_t arena_select = MEMKIND_ARENA_SELECT_HASH;
+    bool hugetlb = (flags == MEMKIND_MASK_PAGE_SIZE_2MB);
+    memkind_t *cached = &memtype_kinds[memtype_flags][policy][hugetlb];
+    int err;
+
+    if (pthread_mutex_lock(&memtype_kinds_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    if (*cached) {
+        *kind = *cached;
+        pthread_mutex_unlock(&memtype_kinds_lock);
+        return MEMKIND_SUCCESS;
+    }
+
+    // arenas of local policies follow the node of the thread, like HBW kinds
+    if (policy == MEMKIND_POLICY_BIND_LOCAL ||
+        policy == MEMKIND_POLICY_PREFERRED_LOCAL ||
+        policy == MEMKIND_POLICY_INTERLEAVE_LOCAL) {
+        arena_select = MEMKIND_ARENA_SELECT_NODE;
+    }
+    snprintf(name, sizeof(name), "memkind_memtype_%x_policy_%d%s",
+             (unsigned)memtype_flags, (int)policy, hugetlb ? "_2mb" : "");
+
+    err = memkind_create(hugetlb ? &MEMKIND_MEMTYPE_HUGETLB_OPS :
+                         &MEMKIND_MEMTYPE_OPS, name, 0, arena_select, kind);
+    if (!err) {
+        err = memkind_memtype_init(*kind, memtype_flags, policy);
+        if (!err) {
+            err = memkind_check_available(*kind);
+        }
+        if (err) {
+            memkind_destroy(*kind);
+            *kind = NULL;
+        } else {
+            *cached = *kind;
+        }
+    }
+    pthread_mutex_unlock(&memtype_kinds_lock);
+    return err;
+}
+
 /* Kind creation */
 MEMKIND_EXPORT int memkind_create_kind(memkind_memtype_t memtype_flags,
                                        memkind_policy_t policy,
@@ -309,8 +448,30 @@ MEMKIND_EXPORT int memkind_create_kind(memkind_memtype_t memtype_flags,
         }
     }
 
-    log_err("Cannot create kind: unsupported set of capabilities.");
-    return MEMKIND_ERROR_INVALID;
+    // preferred policy falls back from a single memory type only
+    if (policy == MEMKIND_POLICY_PREFERRED_LOCAL &&
+        (memtype_flags & (memtype_flags - 1))) {
+        log_err("Cannot create kind: unsupported set of capabilities.");
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    int err = memkind_create_memtype_kind(memtype_flags, policy, flags, kind);
+    switch (err) {
+        case MEMKIND_SUCCESS:
+            return MEMKIND_SUCCESS;
+        case MEMKIND_ERROR_MALLOC:
+        case MEMKIND_ERROR_TOOMANY:
+        case MEMKIND_ERROR_ARENAS_CREATE:
+            log_err("Cannot create kind.");
+            return err;
+        default:
+            if (policy == MEMKIND_POLICY_PREFERRED_LOCAL) {
+                *kind = MEMKIND_DEFAULT;
+                return MEMKIND_SUCCESS;
+            }
+            log_err("Cannot create kind: requested memory type is not available.");
+            return MEMKIND_ERROR_MEMTYPE_NOT_AVAILABLE;
+    }
 }
 
 static void memkind_destroy_kind_from_register(unsigned int i, memkind_t kind)
@@ -322,8 +483,7 @@ static void memkind_destroy_kind_from_register(unsigned int i, memkind_t kind)
     }
 }
 
-/* Kind destruction. */
-MEMKIND_EXPORT int memkind_destroy_kind(memkind_t kind)
+static int memkind_destroy(memkind_t kind)
 {
     if (pthread_mutex_lock(&memkind_registry_g.lock) != 0)
         assert(0 && "failed to acquire mutex");
@@ -341,6 +501,17 @@ MEMKIND_EXPORT int memkind_destroy_kind(memkind_t kind)
     return err;
 }
 
+/* Kind destruction. */
+MEMKIND_EXPORT int memkind_destroy_kind(memkind_t kind)
+{
+    // static kinds and kinds composed by memkind_create_kind() are shared
+    if (kind->partition < MEMKIND_NUM_BASE_KIND ||
+        memkind_is_memtype_kind(kind)) {
+        return MEMKIND_SUCCESS;
+    }
+    return memkind_destroy(kind);
+}
+
 /* Declare weak symbols for allocator decorators */
 extern void memkind_malloc_pre(struct memkind **,
                                size_t *) __attribute__((weak));
@@ -446,6 +617,8 @@ void memkind_init(memkind_t kind, bool check_numa)
 static void nop(void) {}
 
 static int memkind_create(struct memkind_ops *ops, const char *name,
+                          unsigned int arena_num,
+                          memkind_arena_select_t arena_select,
                           struct memkind **kind)
 {
     int err;
@@ -490,7 +663,10 @@ static int memkind_create(struct memkind_ops *ops, const char *name,
         goto exit;
     }
 
-    (*kind)->partition = memkind_registry_g.num_kind;
+    (*kind)->partition = id_kind;
+    /* 0 leaves the number of arenas to memkind_set_arena_map_len() */
+    (*kind)->arena_map_len = arena_num;
+    (*kind)->arena_select = arena_select;
     err = ops->create(*kind, ops, name);
     if (err) {
         jemk_free(*kind);
@@ -550,6 +726,57 @@ MEMKIND_EXPORT int memkind_check_available(struct memkind *kind)
     return err;
 }
 
+static void stats_write_stderr(void *cbopaque, const char *s)
+{
+    fputs(s, stderr);
+}
+
+MEMKIND_EXPORT void memkind_stats_print(void (*write_cb)(void *, const char *),
+                                        void *cbopaque)
+{
+    char buf[512];
+    char name[2 * MEMKIND_NAME_LENGTH_PRIV];
+    memkind_stats_t stats;
+    struct memkind *kind;
+    const char *sep = "";
+    unsigned i, j, k;
+
+    if (!write_cb) {
+        write_cb = stats_write_stderr;
+    }
+
+    if (pthread_mutex_lock(&memkind_registry_g.lock) != 0)
+        assert(0 && "failed to acquire mutex");
+
+    write_cb(cbopaque, "{\"memkind\":{\"kinds\":[");
+    for (i = 0; i < MEMKIND_MAX_KIND; ++i) {
+        kind = memkind_registry_g.partition_map[i];
+        // kinds not used yet have no arenas
+        if (!kind || memkind_arena_stats(kind, &stats)) {
+            continue;
+        }
+        for (j = 0, k = 0; kind->name[j] && k < sizeof(name) - 2; ++j) {
+            if (kind->name[j] == '"' || kind->name[j] == '\\') {
+                name[k++] = '\\';
+            }
+            name[k++] = kind->name[j];
+        }
+        name[k] = '\0';
+        snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"%s\",\"allocated\":%zu,\"active\":%zu,"
+                 "\"resident\":%zu,\"mapped\":%zu,\"retained\":%zu,"
+                 "\"nmalloc\":%zu,\"nfree\":%zu}",
+                 sep, name, stats.allocated, stats.active, stats.resident,
+                 stats.mapped, stats.retained, stats.nmalloc, stats.nfree);
+        write_cb(cbopaque, buf);
+        sep = ",";
+    }
+    write_cb(cbopaque, "]}}\n");
+
+    if (pthread_mutex_unlock(&memkind_registry_g.lock) != 0)
+        assert(0 && "failed to release mutex");
+}
+
 MEMKIND_EXPORT size_t memkind_malloc_usable_size(struct memkind *kind,
                                                  void *ptr)
 {
@@ -561,6 +788,16 @@ MEMKIND_EXPORT size_t memkind_malloc_usable_size(struct memkind *kind,
     return size;
 }
 
+MEMKIND_EXPORT size_t memkind_good_size(struct memkind *kind, size_t size)
+{
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    if (MEMKIND_LIKELY(kind->ops->good_size)) {
+        return kind->ops->good_size(kind, size);
+    }
+    return size;
+}
+
 MEMKIND_EXPORT void *memkind_malloc(struct memkind *kind, size_t size)
 {
     void *result;
@@ -657,6 +894,33 @@ MEMKIND_EXPORT void *memkind_realloc(struct memkind *kind, void *ptr,
     return result;
 }
 
+/*
+ * Finds persistent kind which ptr was allocated from before the kind was
+ * opened. Such objects are not known to jemalloc, so it cannot find them.
+ */
+static struct memkind *memkind_pmem_recovered_kind(void *ptr)
+{
+    struct memkind *kind = NULL;
+    unsigned int i;
+
+    if (MEMKIND_LIKELY(memkind_pmem_recovered_kinds() == 0)) {
+        return NULL;
+    }
+    if (pthread_mutex_lock(&memkind_registry_g.lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    for (i = MEMKIND_NUM_BASE_KIND; i < MEMKIND_MAX_KIND; ++i) {
+        struct memkind *pmem = memkind_registry_g.partition_map[i];
+        if (pmem && pmem->ops == &MEMKIND_PMEM_OPS &&
+            memkind_pmem_is_recovered(pmem, ptr)) {
+            kind = pmem;
+            break;
+        }
+    }
+    if (pthread_mutex_unlock(&memkind_registry_g.lock) != 0)
+        assert(0 && "failed to release mutex");
+    return kind;
+}
+
 MEMKIND_EXPORT void memkind_free(struct memkind *kind, void *ptr)
 {
 #ifdef MEMKIND_DECORATION_ENABLED
@@ -664,6 +928,9 @@ MEMKIND_EXPORT void memkind_free(struct memkind *kind, void *ptr)
         memkind_free_pre(&kind, &ptr);
     }
 #endif
+    if (!kind && ptr) {
+        kind = memkind_pmem_recovered_kind(ptr);
+    }
     if (!kind) {
         heap_manager_free(kind, ptr);
     } else {
@@ -718,9 +985,107 @@ exit:
     return err;
 }
 
-MEMKIND_EXPORT int memkind_create_pmem(const char *dir, size_t max_size,
-                                       struct memkind **kind)
+static int memkind_pmem_get_alignment(size_t *alignment)
+{
+    const char *alignment_env = getenv("MEMKIND_PMEM_ALIGNMENT");
+
+    *alignment = MEMKIND_PMEM_CHUNK_SIZE;
+    if (alignment_env) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        *alignment = strtoul(alignment_env, NULL, 10);
+        if (*alignment < page_size || *alignment > MEMKIND_PMEM_CHUNK_SIZE ||
+            (*alignment & (*alignment - 1))) {
+            log_err("Wrong MEMKIND_PMEM_ALIGNMENT environment value: %zu.",
+                    *alignment);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+    }
+    return 0;
+}
+
+static int memkind_pmem_get_arena_num(unsigned int *arena_num)
+{
+    const char *arena_num_env = getenv("MEMKIND_PMEM_ARENA_NUM_PER_KIND");
+
+    *arena_num = 0;
+    if (arena_num_env) {
+        unsigned long int arena_num_value = strtoul(arena_num_env, NULL, 10);
+        if (arena_num_value == 0 || arena_num_value > INT_MAX) {
+            log_err("Wrong MEMKIND_PMEM_ARENA_NUM_PER_KIND environment value: %lu.",
+                    arena_num_value);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+        *arena_num = arena_num_value;
+    }
+    return 0;
+}
+
+static int memkind_pmem_get_prefault(size_t *watermark)
+{
+    const char *prefault_env = getenv("MEMKIND_PMEM_PREFAULT");
+
+    *watermark = 0;
+    if (prefault_env) {
+        char *end;
+        errno = 0;
+        *watermark = strtoull(prefault_env, &end, 10);
+        if (errno || *end != '\0') {
+            log_err("Wrong MEMKIND_PMEM_PREFAULT environment value: %s.",
+                    prefault_env);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+    }
+    return 0;
+}
+
+MEMKIND_EXPORT struct memkind_config *memkind_config_new(void)
+{
+    struct memkind_config *cfg = jemk_malloc(sizeof(struct memkind_config));
+
+    if (cfg) {
+        cfg->pmem_dir = "/tmp/";
+        cfg->pmem_size = 0;
+        cfg->pmem_reserve = -1;
+        cfg->arena_num = 0;
+    }
+    return cfg;
+}
+
+MEMKIND_EXPORT void memkind_config_delete(struct memkind_config *cfg)
+{
+    jemk_free(cfg);
+}
+
+MEMKIND_EXPORT void memkind_config_set_path(struct memkind_config *cfg,
+                                            const char *pmem_dir)
+{
+    cfg->pmem_dir = pmem_dir;
+}
+
+MEMKIND_EXPORT void memkind_config_set_size(struct memkind_config *cfg,
+                                            size_t pmem_size)
+{
+    cfg->pmem_size = pmem_size;
+}
+
+MEMKIND_EXPORT void memkind_config_set_pmem_reserve(struct memkind_config *cfg,
+                                                    int reserve)
 {
+    cfg->pmem_reserve = reserve != 0;
+}
+
+MEMKIND_EXPORT void memkind_config_set_arena_num(struct memkind_config *cfg,
+                                                 unsigned arena_num)
+{
+    cfg->arena_num = arena_num;
+}
+
+/* options not set in cfg are taken from the environment */
+static int memkind_create_pmem_cfg(const struct memkind_config *cfg,
+                                   struct memkind **kind)
+{
+    const char *dir = cfg->pmem_dir;
+    size_t max_size = cfg->pmem_size;
     int err = 0;
     int oerrno;
 
@@ -733,6 +1098,28 @@ MEMKIND_EXPORT int memkind_create_pmem(const char *dir, size_t max_size,
         max_size = roundup(max_size, MEMKIND_PMEM_CHUNK_SIZE);
     }
 
+    size_t alignment;
+    err = memkind_pmem_get_alignment(&alignment);
+    if (err) {
+        return err;
+    }
+
+    unsigned int arena_num = cfg->arena_num;
+    if (arena_num > INT_MAX) {
+        return MEMKIND_ERROR_INVALID;
+    } else if (arena_num == 0) {
+        err = memkind_pmem_get_arena_num(&arena_num);
+        if (err) {
+            return err;
+        }
+    }
+
+    size_t prefault;
+    err = memkind_pmem_get_prefault(&prefault);
+    if (err) {
+        return err;
+    }
+
     int fd = -1;
     char name[16];
 
@@ -743,7 +1130,8 @@ MEMKIND_EXPORT int memkind_create_pmem(const char *dir, size_t max_size,
 
     snprintf(name, sizeof (name), "pmem%08x", fd);
 
-    err = memkind_create(&MEMKIND_PMEM_OPS, name, kind);
+    err = memkind_create(&MEMKIND_PMEM_OPS, name, arena_num,
+                         MEMKIND_ARENA_SELECT_HASH, kind);
     if (err) {
         goto exit;
     }
@@ -753,6 +1141,217 @@ MEMKIND_EXPORT int memkind_create_pmem(const char *dir, size_t max_size,
     priv->fd = fd;
     priv->offset = 0;
     priv->max_size = max_size;
+    priv->alignment = alignment;
+
+    int reserve = cfg->pmem_reserve;
+    if (reserve == -1) {
+        const char *env = getenv("MEMKIND_PMEM_RESERVE");
+        reserve = env && env[0] == '1';
+    }
+    if (max_size && reserve) {
+        err = memkind_pmem_reserve(*kind);
+        if (err) {
+            /* fd is closed together with the kind */
+            (void) memkind_destroy_kind(*kind);
+            *kind = NULL;
+            return err;
+        }
+    }
+
+    if (prefault) {
+        err = memkind_pmem_prefault(*kind, prefault);
+        if (err) {
+            (void) memkind_destroy_kind(*kind);
+            *kind = NULL;
+        }
+    }
+
+    return err;
+
+exit:
+    oerrno = errno;
+    if (fd != -1) {
+        (void) close(fd);
+    }
+    errno = oerrno;
+    return err;
+}
+
+MEMKIND_EXPORT int memkind_create_pmem(const char *dir, size_t max_size,
+                                       struct memkind **kind)
+{
+    struct memkind_config cfg = {
+        .pmem_dir = dir,
+        .pmem_size = max_size,
+        .pmem_reserve = -1,
+        .arena_num = 0
+    };
+
+    return memkind_create_pmem_cfg(&cfg, kind);
+}
+
+MEMKIND_EXPORT int memkind_create_pmem_with_config(struct memkind_config *cfg,
+                                                   struct memkind **kind)
+{
+    if (!cfg) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    return memkind_create_pmem_cfg(cfg, kind);
+}
+
+MEMKIND_EXPORT int memkind_create_pmem_multi(const char *const *dirs,
+                                             size_t num, size_t max_size,
+                                             struct memkind **kind)
+{
+    int err = 0;
+    int oerrno;
+    size_t i;
+
+    if (!dirs || num == 0) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    if (num == 1) {
+        return memkind_create_pmem(dirs[0], max_size, kind);
+    }
+
+    if (max_size && max_size < num * MEMKIND_PMEM_MIN_SIZE) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    size_t alignment;
+    err = memkind_pmem_get_alignment(&alignment);
+    if (err) {
+        return err;
+    }
+
+    unsigned int arena_num;
+    err = memkind_pmem_get_arena_num(&arena_num);
+    if (err) {
+        return err;
+    }
+
+    size_t prefault;
+    err = memkind_pmem_get_prefault(&prefault);
+    if (err) {
+        return err;
+    }
+
+    int *fds = malloc(num * sizeof(int));
+    if (!fds) {
+        return MEMKIND_ERROR_MALLOC;
+    }
+
+    for (i = 0; i < num; ++i) {
+        fds[i] = -1;
+    }
+
+    for (i = 0; i < num; ++i) {
+        err = memkind_tmpfile(dirs[i], &fds[i]);
+        if (err) {
+            goto exit;
+        }
+    }
+
+    char name[16];
+    snprintf(name, sizeof (name), "pmem%08x", fds[0]);
+
+    err = memkind_create(&MEMKIND_PMEM_OPS, name, arena_num,
+                         MEMKIND_ARENA_SELECT_HASH, kind);
+    if (err) {
+        goto exit;
+    }
+
+    struct memkind_pmem *priv = (*kind)->priv;
+
+    priv->max_size = max_size;
+    priv->alignment = alignment;
+
+    err = memkind_pmem_create_stripes(*kind, fds, num);
+    if (err) {
+        (void) memkind_destroy_kind(*kind);
+        *kind = NULL;
+        goto exit;
+    }
+
+    free(fds);
+
+    if (prefault) {
+        err = memkind_pmem_prefault(*kind, prefault);
+        if (err) {
+            (void) memkind_destroy_kind(*kind);
+            *kind = NULL;
+        }
+    }
+
+    return err;
+
+exit:
+    oerrno = errno;
+    for (i = 0; i < num; ++i) {
+        if (fds[i] != -1) {
+            (void) close(fds[i]);
+        }
+    }
+    free(fds);
+    errno = oerrno;
+    return err;
+}
+
+MEMKIND_EXPORT int memkind_open_pmem(const char *path, size_t max_size,
+                                     struct memkind **kind)
+{
+    int err = 0;
+    int oerrno;
+
+    /* persistent heap is mapped at once, so its size must be known */
+    if (max_size < MEMKIND_PMEM_MIN_SIZE) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    /* round up to a multiple of jemalloc chunk size */
+    max_size = roundup(max_size, MEMKIND_PMEM_CHUNK_SIZE);
+
+    size_t alignment;
+    err = memkind_pmem_get_alignment(&alignment);
+    if (err) {
+        return err;
+    }
+
+    unsigned int arena_num;
+    err = memkind_pmem_get_arena_num(&arena_num);
+    if (err) {
+        return err;
+    }
+
+    char name[16];
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        err = MEMKIND_ERROR_RUNTIME;
+        goto exit;
+    }
+
+    snprintf(name, sizeof (name), "pmem%08x", fd);
+
+    err = memkind_create(&MEMKIND_PMEM_OPS, name, arena_num,
+                         MEMKIND_ARENA_SELECT_HASH, kind);
+    if (err) {
+        goto exit;
+    }
+
+    struct memkind_pmem *priv = (*kind)->priv;
+
+    priv->fd = fd;
+    priv->offset = 0;
+    priv->max_size = max_size;
+    priv->alignment = alignment;
+
+    err = memkind_pmem_open(*kind);
+    if (err) {
+        /* fd is closed together with the kind */
+        (void) memkind_destroy_kind(*kind);
+        *kind = NULL;
+    }
 
     return err;
 
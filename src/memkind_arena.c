@@ -25,11 +25,13 @@
 #include <memkind.h>
 #include <memkind/internal/memkind_default.h>
 #include <memkind/internal/memkind_arena.h>
+#include <memkind/internal/memkind_hugetlb.h>
 #include <memkind/internal/memkind_private.h>
 #include <memkind/internal/memkind_log.h>
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 #include <stdint.h>
 #include <unistd.h>
@@ -44,14 +46,28 @@
 #include <limits.h>
 #include <sys/mman.h>
 #include <assert.h>
+#include <time.h>
 
 #include "config.h"
 
 #define HUGE_PAGE_SIZE (1ull << MEMKIND_MASK_PAGE_SIZE_2MB)
 
+#ifndef MADV_FREE
+#define MADV_FREE 8
+#endif
+
+// default max allocation size to be cached by tcache mechanism
+#define TCACHE_MAX (1<<12)
+// upper bound of per-kind tcache_max
+// should be aligned with jemalloc opt.lg_tcache_max
+#define TCACHE_MAX_LIMIT (1<<15)
+
 static void *jemk_mallocx_check(size_t size, int flags);
 static void *jemk_rallocx_check(void *ptr, size_t size, int flags);
 static void tcache_finalize(void* args);
+static void tcache_destroy_partition(unsigned partition);
+static int background_purge_init(void);
+static void extent_caches_expire(void);
 
 static unsigned int integer_log2(unsigned int v)
 {
@@ -80,7 +96,9 @@ MEMKIND_EXPORT int memkind_set_arena_map_len(struct memkind *kind)
     } else if (kind->ops->get_arena == memkind_thread_get_arena) {
         char *arena_num_env = getenv("MEMKIND_ARENA_NUM_PER_KIND");
 
-        if (arena_num_env) {
+        if (kind->arena_map_len) {
+            /* number of arenas chosen by creator of the kind */
+        } else if (arena_num_env) {
             unsigned long int arena_num_value = strtoul(arena_num_env, NULL, 10);
 
             if ((arena_num_value == 0) || (arena_num_value > INT_MAX)) {
@@ -106,23 +124,226 @@ MEMKIND_EXPORT int memkind_set_arena_map_len(struct memkind *kind)
     return 0;
 }
 
+static int memkind_set_tcache_max_env(struct memkind *kind)
+{
+    const char *tcache_max_env = getenv("MEMKIND_TCACHE_MAX");
+
+    kind->tcache_max = TCACHE_MAX;
+    if (tcache_max_env) {
+        char *end;
+        errno = 0;
+        unsigned long long tcache_max = strtoull(tcache_max_env, &end, 10);
+        if (errno || *end != '\0' || tcache_max > TCACHE_MAX_LIMIT) {
+            log_err("Wrong MEMKIND_TCACHE_MAX environment value: %s.",
+                    tcache_max_env);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+        kind->tcache_max = tcache_max;
+    }
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_set_tcache_max(struct memkind *kind,
+                                          size_t max_size)
+{
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    if (kind->arena_map_len == 0 || max_size > TCACHE_MAX_LIMIT) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    kind->tcache_max = max_size;
+    return 0;
+}
+
+static int memkind_set_purge_env(struct memkind *kind)
+{
+    const char *purge_env = getenv("MEMKIND_PURGE");
+
+    kind->purge = MEMKIND_PURGE_LAZY;
+    if (purge_env == NULL || strcmp(purge_env, "lazy") == 0) {
+        return 0;
+    } else if (strcmp(purge_env, "forced") == 0) {
+        kind->purge = MEMKIND_PURGE_FORCED;
+    } else {
+        log_err("Wrong MEMKIND_PURGE environment value: %s.", purge_env);
+        return MEMKIND_ERROR_ENVIRON;
+    }
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_set_purge(struct memkind *kind,
+                                     memkind_purge_t purge)
+{
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    if (kind->arena_map_len == 0) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    switch (purge) {
+        case MEMKIND_PURGE_LAZY:
+        case MEMKIND_PURGE_FORCED:
+            kind->purge = purge;
+            return 0;
+        default:
+            return MEMKIND_ERROR_INVALID;
+    }
+}
+
+static int memkind_set_arena_select_env(struct memkind *kind)
+{
+    const char *select_env = getenv("MEMKIND_ARENA_SELECT");
+
+    if (select_env == NULL) {
+        /* strategy chosen by creator of the kind */
+    } else if (strcmp(select_env, "hash") == 0) {
+        kind->arena_select = MEMKIND_ARENA_SELECT_HASH;
+    } else if (strcmp(select_env, "cpu") == 0) {
+        kind->arena_select = MEMKIND_ARENA_SELECT_CPU;
+    } else if (strcmp(select_env, "round_robin") == 0) {
+        kind->arena_select = MEMKIND_ARENA_SELECT_ROUND_ROBIN;
+    } else if (strcmp(select_env, "node") == 0) {
+        kind->arena_select = MEMKIND_ARENA_SELECT_NODE;
+    } else {
+        log_err("Wrong MEMKIND_ARENA_SELECT environment value: %s.", select_env);
+        return MEMKIND_ERROR_ENVIRON;
+    }
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_set_arena_select(struct memkind *kind,
+                                            memkind_arena_select_t select)
+{
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    if (kind->ops->get_arena != memkind_thread_get_arena ||
+        kind->arena_map_len == 0) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    switch (select) {
+        case MEMKIND_ARENA_SELECT_HASH:
+        case MEMKIND_ARENA_SELECT_CPU:
+        case MEMKIND_ARENA_SELECT_ROUND_ROBIN:
+        case MEMKIND_ARENA_SELECT_NODE:
+            kind->arena_select = select;
+            return 0;
+        default:
+            return MEMKIND_ERROR_INVALID;
+    }
+}
+
+static int memkind_get_decay_env(const char *name, ssize_t *decay_ms)
+{
+    const char *decay_env = getenv(name);
+
+    if (decay_env) {
+        char *end;
+        errno = 0;
+        long long val = strtoll(decay_env, &end, 10);
+        if (errno || *end != '\0' || val < -1 || val > SSIZE_MAX) {
+            log_err("Wrong %s environment value: %s.", name, decay_env);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+        *decay_ms = val;
+    }
+    return 0;
+}
+
+static int memkind_set_decay_env(struct memkind *kind)
+{
+    size_t ssize_size = sizeof(ssize_t);
+    int err;
+
+    // jemalloc defaults for new arenas
+    err = jemk_mallctl("arenas.dirty_decay_ms", &kind->dirty_decay_ms,
+                       &ssize_size, NULL, 0);
+    if (!err) {
+        err = jemk_mallctl("arenas.muzzy_decay_ms", &kind->muzzy_decay_ms,
+                           &ssize_size, NULL, 0);
+    }
+    if (err) {
+        log_err("Could not read decay time of arenas.");
+        return MEMKIND_ERROR_INVALID;
+    }
+    err = memkind_get_decay_env("MEMKIND_DIRTY_DECAY_MS", &kind->dirty_decay_ms);
+    if (!err) {
+        err = memkind_get_decay_env("MEMKIND_MUZZY_DECAY_MS", &kind->muzzy_decay_ms);
+    }
+    return err;
+}
+
+static int arena_set_decay(unsigned arena, ssize_t dirty_decay_ms,
+                           ssize_t muzzy_decay_ms)
+{
+    char cmd[64];
+
+    snprintf(cmd, sizeof(cmd), "arena.%u.dirty_decay_ms", arena);
+    if (jemk_mallctl(cmd, NULL, NULL, &dirty_decay_ms, sizeof(ssize_t))) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    snprintf(cmd, sizeof(cmd), "arena.%u.muzzy_decay_ms", arena);
+    if (jemk_mallctl(cmd, NULL, NULL, &muzzy_decay_ms, sizeof(ssize_t))) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    return 0;
+}
+
 static pthread_once_t arena_config_once = PTHREAD_ONCE_INIT;
 static int arena_init_status;
 
 static pthread_key_t tcache_key;
 static bool memkind_hog_memory;
+static bool madvise_free_unsupported;
+
+/*
+ * Arena maps of kinds selecting arenas by node are split into arena_node_num
+ * equal sets of slots, the set of a NUMA node is at index node * slots.
+ */
+static unsigned arena_node_num = 1; // power of 2 covering all node ids
+static int *cpu_node_g;             // NUMA node of each CPU
+static int cpu_node_len;
+
+static void arena_node_init(void)
+{
+    int cpu, node;
+
+    arena_node_num = round_pow2_up(numa_max_node() + 1);
+    cpu_node_len = numa_num_configured_cpus();
+    cpu_node_g = jemk_malloc(sizeof(int) * cpu_node_len);
+    if (!cpu_node_g) {
+        cpu_node_len = 0;
+        return;
+    }
+    for (cpu = 0; cpu < cpu_node_len; ++cpu) {
+        node = numa_node_of_cpu(cpu);
+        cpu_node_g[cpu] = node < 0 ? 0 : node;
+    }
+}
 
 static void arena_config_init()
 {
     const char* str = getenv("MEMKIND_HOG_MEMORY");
     memkind_hog_memory = str && str[0] == '1';
+    arena_node_init();
 
     arena_init_status = pthread_key_create(&tcache_key, tcache_finalize);
+    if (!arena_init_status) {
+        arena_init_status = background_purge_init();
+    }
 }
 
 #define MALLOCX_ARENA_MAX 0xffe // copy-pasted from jemalloc/internal/jemalloc_internal.h
 static struct memkind *arena_registry_g[MALLOCX_ARENA_MAX];
 static pthread_mutex_t arena_registry_write_lock;
+static unsigned arena_registry_max; // highest arena index in the registry
+// NUMA node + 1 of arenas in node sets of slots, 0 for other arenas
+static unsigned short arena_node_g[MALLOCX_ARENA_MAX];
+// NUMA node + 1 of the arena whose extent is being allocated by the thread
+static __thread unsigned short extent_node MEMKIND_TLS_MODEL;
+
+int memkind_arena_extent_node(void)
+{
+    return (int)extent_node - 1;
+}
 
 struct memkind *get_kind_by_arena(unsigned arena_ind)
 {
@@ -133,6 +354,140 @@ struct memkind *get_kind_by_arena(unsigned arena_ind)
     return arena_registry_g[arena_ind];
 }
 
+/*
+ * Background purge thread periodically runs decay of arenas of all kinds,
+ * so that epochs of jemalloc decay advance off the allocation path and
+ * dirty and muzzy pages are returned to the OS on schedule even when the
+ * kind is idle. Expired address space of extent caches is unmapped too.
+ */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+    unsigned interval_ms;
+} background_purge = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void background_purge_run(void)
+{
+    unsigned max = __atomic_load_n(&arena_registry_max, __ATOMIC_ACQUIRE);
+    unsigned i;
+    char cmd[64];
+
+    for (i = 1; i <= max; ++i) {
+        if (__atomic_load_n(&arena_registry_g[i], __ATOMIC_ACQUIRE)) {
+            snprintf(cmd, sizeof(cmd), "arena.%u.decay", i);
+            jemk_mallctl(cmd, NULL, NULL, NULL, 0);
+        }
+    }
+    extent_caches_expire();
+}
+
+static void *background_purge_thread(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&background_purge.lock);
+    while (background_purge.interval_ms) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += background_purge.interval_ms / 1000;
+        deadline.tv_nsec += (background_purge.interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        if (pthread_cond_timedwait(&background_purge.cond,
+                                   &background_purge.lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&background_purge.lock);
+            background_purge_run();
+            pthread_mutex_lock(&background_purge.lock);
+        }
+    }
+    pthread_mutex_unlock(&background_purge.lock);
+    return NULL;
+}
+
+MEMKIND_EXPORT int memkind_set_background_purge(unsigned interval_ms)
+{
+    pthread_t thread;
+    bool join = false;
+    int err = 0;
+
+    pthread_once(&arena_config_once, arena_config_init);
+
+    pthread_mutex_lock(&background_purge.lock);
+    background_purge.interval_ms = interval_ms;
+    if (interval_ms && !background_purge.running) {
+        err = pthread_create(&background_purge.thread, NULL,
+                             background_purge_thread, NULL);
+        if (err) {
+            log_err("pthread_create() failed.");
+            background_purge.interval_ms = 0;
+            err = MEMKIND_ERROR_RUNTIME;
+        } else {
+            background_purge.running = true;
+        }
+    } else if (!interval_ms && background_purge.running) {
+        background_purge.running = false;
+        thread = background_purge.thread;
+        join = true;
+    }
+    pthread_cond_signal(&background_purge.cond);
+    pthread_mutex_unlock(&background_purge.lock);
+
+    if (join) {
+        pthread_join(thread, NULL);
+    }
+    return err;
+}
+
+static void background_purge_atfork_child(void)
+{
+    // the thread is not duplicated by fork
+    pthread_mutex_init(&background_purge.lock, NULL);
+    pthread_cond_init(&background_purge.cond, NULL);
+    background_purge.running = false;
+    background_purge.interval_ms = 0;
+}
+
+static int background_purge_init(void)
+{
+    const char *env = getenv("MEMKIND_BACKGROUND_PURGE_MS");
+    pthread_condattr_t attr;
+    unsigned long interval_ms = 0;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&background_purge.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_atfork(NULL, NULL, background_purge_atfork_child);
+
+    if (env) {
+        char *end;
+        errno = 0;
+        interval_ms = strtoul(env, &end, 10);
+        if (errno || *end != '\0' || interval_ms > UINT_MAX) {
+            log_err("Wrong MEMKIND_BACKGROUND_PURGE_MS environment value: %s.", env);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+    }
+    if (interval_ms) {
+        pthread_mutex_lock(&background_purge.lock);
+        background_purge.interval_ms = interval_ms;
+        if (pthread_create(&background_purge.thread, NULL,
+                           background_purge_thread, NULL)) {
+            log_err("pthread_create() failed.");
+            background_purge.interval_ms = 0;
+        } else {
+            background_purge.running = true;
+        }
+        pthread_mutex_unlock(&background_purge.lock);
+    }
+    return 0;
+}
+
 // Allocates size bytes aligned to alignment. Returns NULL if allocation fails.
 static void *alloc_aligned_slow(size_t size, size_t alignment,
                                 struct memkind* kind)
@@ -149,39 +504,623 @@ static void *alloc_aligned_slow(size_t size, size_t alignment,
     uintptr_t addr = (uintptr_t)ptr;
     uintptr_t aligned_addr = (addr + alignment) & ~(alignment - 1);
 
-    size_t head_len = aligned_addr - addr;
-    if (head_len > 0) {
-        munmap(ptr, head_len);
-    }
+    size_t head_len = aligned_addr - addr;
+    if (head_len > 0) {
+        munmap(ptr, head_len);
+    }
+
+    uintptr_t tail = aligned_addr + size;
+    size_t tail_len = (addr + extended_size) - (aligned_addr + size);
+    if (tail_len > 0) {
+        munmap((void*)tail, tail_len);
+    }
+
+    return (void*)aligned_addr;
+}
+
+
+/*
+ * Extents released by jemalloc arenas of anonymous kinds are kept mapped,
+ * with their NUMA policy, for up to decay_ms and reused by later extent
+ * allocations. Their pages are dropped when cached, so the cache holds
+ * virtual address space only, bounded by max_size per kind. Expired extents
+ * are unmapped when the cache is used or purged, and by the background purge
+ * thread, so caches of idle kinds shrink too.
+ */
+struct extent_cache_entry {
+    struct extent_cache_entry *prev;
+    struct extent_cache_entry *next;
+    void *addr;
+    size_t size;
+    uint64_t time_ms;
+    unsigned node; // NUMA node + 1 of the arena which released the extent
+};
+
+struct memkind_extent_cache {
+    pthread_mutex_t lock;
+    struct extent_cache_entry *head; // most recently cached
+    struct extent_cache_entry *tail; // least recently cached
+    size_t size;
+    size_t max_size;
+    unsigned decay_ms;
+    size_t unit; // extents must be multiples of mapping page size
+    struct memkind_extent_cache *next; // in the list of caches of all kinds
+};
+
+static struct memkind_extent_cache *extent_caches;
+static pthread_mutex_t extent_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define EXTENT_CACHE_MAX_DEFAULT (64ull << 20)
+#define EXTENT_CACHE_DECAY_MS_DEFAULT 10000
+
+static uint64_t extent_cache_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void extent_cache_unlink(struct memkind_extent_cache *cache,
+                                struct extent_cache_entry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    cache->size -= entry->size;
+}
+
+static void extent_cache_push(struct memkind_extent_cache *cache,
+                              struct extent_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+    cache->size += entry->size;
+}
+
+/*
+ * Moves extents expired or exceeding max_size - reserve to the evicted list,
+ * called with cache lock held.
+ */
+static void extent_cache_evict(struct memkind_extent_cache *cache,
+                               size_t reserve,
+                               struct extent_cache_entry **evicted)
+{
+    uint64_t now = extent_cache_now_ms();
+
+    while (cache->tail &&
+           (cache->size + reserve > cache->max_size ||
+            now - cache->tail->time_ms >= cache->decay_ms)) {
+        struct extent_cache_entry *entry = cache->tail;
+        extent_cache_unlink(cache, entry);
+        entry->next = *evicted;
+        *evicted = entry;
+    }
+}
+
+static void extent_cache_unmap(struct extent_cache_entry *evicted)
+{
+    while (evicted) {
+        struct extent_cache_entry *next = evicted->next;
+        munmap(evicted->addr, evicted->size);
+        jemk_free(evicted);
+        evicted = next;
+    }
+}
+
+// Returns false when the extent was cached or unmapped.
+static bool extent_cache_put(struct memkind_extent_cache *cache, void *addr,
+                             size_t size, unsigned node)
+{
+    struct extent_cache_entry *evicted = NULL;
+    struct extent_cache_entry *entry = NULL;
+
+    if (((uintptr_t)addr | size) & (cache->unit - 1)) {
+        // part of a huge page, let jemalloc retain it
+        return true;
+    }
+    if (size > cache->max_size) {
+        // keep only the part that fits, the rest goes back to the OS
+        size_t excess = size - (cache->max_size & ~(cache->unit - 1));
+        munmap(addr, excess);
+        addr = (char *)addr + excess;
+        size -= excess;
+        if (size == 0) {
+            return false;
+        }
+    }
+    entry = jemk_malloc(sizeof(struct extent_cache_entry));
+    if (entry) {
+        if (!memkind_hog_memory) {
+            madvise(addr, size, MADV_DONTNEED);
+        }
+        entry->addr = addr;
+        entry->size = size;
+        entry->time_ms = extent_cache_now_ms();
+        entry->node = node;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    extent_cache_evict(cache, entry ? size : 0, &evicted);
+    if (entry) {
+        extent_cache_push(cache, entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    extent_cache_unmap(evicted);
+    if (!entry) {
+        munmap(addr, size);
+    }
+    return false;
+}
+
+static void *extent_cache_get(struct memkind_extent_cache *cache, size_t size,
+                              size_t alignment, unsigned node)
+{
+    struct extent_cache_entry *evicted = NULL;
+    struct extent_cache_entry *entry;
+    struct extent_cache_entry *unused = NULL;
+    void *addr = NULL;
+
+    if (size & (cache->unit - 1)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    extent_cache_evict(cache, 0, &evicted);
+    for (entry = cache->head; entry; entry = entry->next) {
+        uintptr_t start = (uintptr_t)entry->addr;
+        uintptr_t aligned = (start + alignment - 1) & ~(alignment - 1);
+        uintptr_t end = start + entry->size;
+
+        if (aligned + size > end || ((aligned - start) & (cache->unit - 1)) ||
+            entry->node != node) {
+            continue;
+        }
+        addr = (void *)aligned;
+        cache->size -= size;
+        // remainders before and after the extent stay in place in the cache
+        if (aligned > start && aligned + size < end) {
+            struct extent_cache_entry *tail =
+                jemk_malloc(sizeof(struct extent_cache_entry));
+            entry->size = aligned - start;
+            if (tail) {
+                tail->addr = (void *)(aligned + size);
+                tail->size = end - (aligned + size);
+                tail->time_ms = entry->time_ms;
+                tail->node = entry->node;
+                tail->prev = entry;
+                tail->next = entry->next;
+                if (entry->next) {
+                    entry->next->prev = tail;
+                } else {
+                    cache->tail = tail;
+                }
+                entry->next = tail;
+            } else {
+                cache->size -= end - (aligned + size);
+                munmap((void *)(aligned + size), end - (aligned + size));
+            }
+        } else if (aligned > start) {
+            entry->size = aligned - start;
+        } else if (aligned + size < end) {
+            entry->addr = (void *)(aligned + size);
+            entry->size = end - (aligned + size);
+        } else {
+            cache->size += size;
+            extent_cache_unlink(cache, entry);
+            unused = entry;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    extent_cache_unmap(evicted);
+    jemk_free(unused);
+    return addr;
+}
+
+/*
+ * Anonymous kinds mapping regular pages carve their extents out of large
+ * regions of address space, each mapped, bound and advised with a single
+ * call instead of one of each per extent. The nodes bound by some kinds
+ * depend on the CPU of the calling thread, so regions are kept per node mask.
+ * Address space of an extent is never carved twice: once released it goes
+ * through the extent cache like any other mapping.
+ */
+#define REGION_SIZE_DEFAULT (64ull << 20)
+#define REGION_SLOTS 8
+
+struct memkind_region {
+    nodemask_t nodemask;
+    uintptr_t next;
+    uintptr_t end;
+};
+
+struct memkind_region_pool {
+    pthread_mutex_t lock;
+    size_t region_size;
+    size_t map_syscalls; // syscalls needed to map memory of the kind
+    size_t syscalls_avoided;
+    size_t syscalls_spent;
+    unsigned num;
+    unsigned victim;
+    struct memkind_region regions[REGION_SLOTS];
+    memkind_region_stats_t stats;
+};
+
+// Unmaps unused tail of the region, called with pool lock held.
+static void region_retire(struct memkind_region_pool *pool,
+                          struct memkind_region *region)
+{
+    if (region->next < region->end) {
+        munmap((void *)region->next, region->end - region->next);
+        pool->syscalls_spent++;
+    }
+    region->next = region->end = 0;
+}
+
+static void *region_alloc(struct memkind *kind, size_t size, size_t alignment)
+{
+    struct memkind_region_pool *pool = kind->region_pool;
+    struct memkind_region *region = NULL;
+    nodemask_t nodemask;
+    uintptr_t start;
+    unsigned i;
+
+    if (size > pool->region_size / 2) {
+        return NULL;
+    }
+    memset(&nodemask, 0, sizeof(nodemask));
+    if (kind->ops->get_mbind_nodemask &&
+        kind->ops->get_mbind_nodemask(kind, nodemask.n, NUMA_NUM_NODES)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < pool->num; ++i) {
+        if (!memcmp(&pool->regions[i].nodemask, &nodemask, sizeof(nodemask))) {
+            region = &pool->regions[i];
+            break;
+        }
+    }
+    if (!region) {
+        if (pool->num < REGION_SLOTS) {
+            region = &pool->regions[pool->num++];
+        } else {
+            region = &pool->regions[pool->victim++ % REGION_SLOTS];
+            region_retire(pool, region);
+        }
+        region->nodemask = nodemask;
+    }
+    start = (region->next + alignment - 1) & ~(alignment - 1);
+    if (region->next == 0 || start + size > region->end) {
+        void *base;
+        region_retire(pool, region);
+        base = kind_mmap(kind, NULL, pool->region_size);
+        if (base == MAP_FAILED) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        region->next = (uintptr_t)base;
+        region->end = region->next + pool->region_size;
+        pool->syscalls_spent += pool->map_syscalls;
+        pool->stats.regions++;
+        start = (region->next + alignment - 1) & ~(alignment - 1);
+        if (start + size > region->end) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+    }
+    if (start > region->next) {
+        munmap((void *)region->next, start - region->next);
+        pool->syscalls_spent++;
+    }
+    region->next = start + size;
+    pool->syscalls_avoided += pool->map_syscalls;
+    pool->stats.extents++;
+    pthread_mutex_unlock(&pool->lock);
+
+    return (void *)start;
+}
+
+static int arena_get_env(const char *name, size_t max,
+                                unsigned long long *value)
+{
+    const char *env = getenv(name);
+    if (env) {
+        char *end;
+        errno = 0;
+        unsigned long long val = strtoull(env, &end, 10);
+        if (errno || *end != '\0' || val > max) {
+            log_err("Wrong %s environment value: %s.", name, env);
+            return MEMKIND_ERROR_ENVIRON;
+        }
+        *value = val;
+    }
+    return 0;
+}
+
+static int extent_cache_create(struct memkind *kind)
+{
+    unsigned long long max_size = EXTENT_CACHE_MAX_DEFAULT;
+    unsigned long long decay_ms = EXTENT_CACHE_DECAY_MS_DEFAULT;
+    struct memkind_extent_cache *cache;
+    int flags = 0;
+
+    int err = arena_get_env("MEMKIND_EXTENT_CACHE_MAX", SIZE_MAX, &max_size);
+    if (!err) {
+        err = arena_get_env("MEMKIND_EXTENT_CACHE_DECAY_MS", UINT_MAX,
+                                   &decay_ms);
+    }
+    if (err) {
+        return err;
+    }
+    cache = jemk_calloc(1, sizeof(struct memkind_extent_cache));
+    if (!cache) {
+        log_err("jemk_calloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->max_size = max_size;
+    cache->decay_ms = decay_ms;
+    cache->unit = sysconf(_SC_PAGESIZE);
+    if (kind->ops->get_mmap_flags) {
+        kind->ops->get_mmap_flags(kind, &flags);
+    }
+    if (flags & MAP_HUGETLB) {
+        cache->unit = HUGE_PAGE_SIZE;
+    }
+    pthread_mutex_lock(&extent_caches_lock);
+    cache->next = extent_caches;
+    extent_caches = cache;
+    pthread_mutex_unlock(&extent_caches_lock);
+    kind->extent_cache = cache;
+    return 0;
+}
+
+static int region_pool_create(struct memkind *kind)
+{
+    unsigned long long region_size = REGION_SIZE_DEFAULT;
+    struct memkind_region_pool *pool;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int flags = 0;
+
+    int err = arena_get_env("MEMKIND_REGION_SIZE", SIZE_MAX - page_size,
+                            &region_size);
+    if (err) {
+        return err;
+    }
+    if (kind->ops->get_mmap_flags) {
+        kind->ops->get_mmap_flags(kind, &flags);
+    }
+    // huge pages would be reserved for the whole region
+    if (region_size == 0 || flags != (MAP_PRIVATE | MAP_ANONYMOUS)) {
+        return 0;
+    }
+    pool = jemk_calloc(1, sizeof(struct memkind_region_pool));
+    if (!pool) {
+        log_err("jemk_calloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->region_size = (region_size + page_size - 1) & ~(page_size - 1);
+    pool->map_syscalls = 1 + (kind->ops->mbind != NULL) +
+                         (kind->ops->madvise != NULL);
+    kind->region_pool = pool;
+    return 0;
+}
+
+static void region_pool_destroy(struct memkind *kind)
+{
+    struct memkind_region_pool *pool = kind->region_pool;
+    unsigned i;
+
+    if (pool) {
+        for (i = 0; i < pool->num; ++i) {
+            region_retire(pool, &pool->regions[i]);
+        }
+        pthread_mutex_destroy(&pool->lock);
+        jemk_free(pool);
+        kind->region_pool = NULL;
+    }
+}
+
+MEMKIND_EXPORT int memkind_get_region_stats(struct memkind *kind,
+                                            memkind_region_stats_t *stats)
+{
+    struct memkind_region_pool *pool;
+
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    pool = kind->region_pool;
+    if (!pool || !stats) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    stats->syscalls_saved = pool->syscalls_avoided > pool->syscalls_spent ?
+                            pool->syscalls_avoided - pool->syscalls_spent : 0;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+static void extent_cache_destroy(struct memkind *kind)
+{
+    struct memkind_extent_cache *cache = kind->extent_cache;
+
+    if (cache) {
+        struct memkind_extent_cache **prev;
+        pthread_mutex_lock(&extent_caches_lock);
+        for (prev = &extent_caches; *prev != cache; prev = &(*prev)->next);
+        *prev = cache->next;
+        pthread_mutex_unlock(&extent_caches_lock);
+        extent_cache_unmap(cache->head);
+        pthread_mutex_destroy(&cache->lock);
+        jemk_free(cache);
+        kind->extent_cache = NULL;
+    }
+}
+
+// Unmaps expired extents of caches of all kinds.
+static void extent_caches_expire(void)
+{
+    struct memkind_extent_cache *cache;
+
+    pthread_mutex_lock(&extent_caches_lock);
+    for (cache = extent_caches; cache; cache = cache->next) {
+        struct extent_cache_entry *evicted = NULL;
+        pthread_mutex_lock(&cache->lock);
+        extent_cache_evict(cache, 0, &evicted);
+        pthread_mutex_unlock(&cache->lock);
+        extent_cache_unmap(evicted);
+    }
+    pthread_mutex_unlock(&extent_caches_lock);
+}
+
+MEMKIND_EXPORT int memkind_set_extent_cache(struct memkind *kind,
+                                            size_t max_size, unsigned decay_ms)
+{
+    struct extent_cache_entry *evicted = NULL;
+    struct memkind_extent_cache *cache;
+
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    cache = kind->extent_cache;
+    if (!cache) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    pthread_mutex_lock(&cache->lock);
+    cache->max_size = max_size;
+    cache->decay_ms = decay_ms;
+    extent_cache_evict(cache, 0, &evicted);
+    pthread_mutex_unlock(&cache->lock);
+    extent_cache_unmap(evicted);
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_arena_purge(struct memkind *kind)
+{
+    struct extent_cache_entry *evicted = NULL;
+    unsigned i;
+    char cmd[64];
+
+    for (i = 0; kind->arena_map && i < kind->arena_map_len; ++i) {
+        unsigned arena = __atomic_load_n(&kind->arena_map[i], __ATOMIC_ACQUIRE);
+        if (arena) {
+            snprintf(cmd, sizeof(cmd), "arena.%u.purge", arena);
+            jemk_mallctl(cmd, NULL, NULL, NULL, 0);
+        }
+    }
+    if (kind->extent_cache) {
+        pthread_mutex_lock(&kind->extent_cache->lock);
+        extent_cache_evict(kind->extent_cache, 0, &evicted);
+        pthread_mutex_unlock(&kind->extent_cache->lock);
+        extent_cache_unmap(evicted);
+    }
+    return 0;
+}
+
+static void thread_partition_sum(unsigned partition, size_t *nmalloc,
+                                 size_t *nfree);
+
+static size_t arena_stat_get(unsigned arena, const char *name)
+{
+    size_t value = 0;
+    size_t size = sizeof(value);
+    char cmd[128];
+
+    snprintf(cmd, sizeof(cmd), "stats.arenas.%u.%s", arena, name);
+    jemk_mallctl(cmd, (void *)&value, &size, NULL, 0);
+    return value;
+}
+
+int memkind_arena_stats(struct memkind *kind, memkind_stats_t *stats)
+{
+    static size_t page_size;
+    uint64_t epoch = 1;
+    unsigned i;
 
-    uintptr_t tail = aligned_addr + size;
-    size_t tail_len = (addr + extended_size) - (aligned_addr + size);
-    if (tail_len > 0) {
-        munmap((void*)tail, tail_len);
+    if (!kind->arena_map || !stats) {
+        return MEMKIND_ERROR_INVALID;
     }
-
-    return (void*)aligned_addr;
+    if (!page_size) {
+        page_size = sysconf(_SC_PAGESIZE);
+    }
+    memset(stats, 0, sizeof(memkind_stats_t));
+    // jemalloc refreshes its cached statistics on every epoch update
+    jemk_mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch));
+    for (i = 0; i < kind->arena_map_len; ++i) {
+        unsigned arena = __atomic_load_n(&kind->arena_map[i], __ATOMIC_ACQUIRE);
+        if (arena == 0) {
+            continue;
+        }
+        stats->allocated += arena_stat_get(arena, "small.allocated") +
+                            arena_stat_get(arena, "large.allocated");
+        stats->active += arena_stat_get(arena, "pactive") * page_size;
+        stats->resident += arena_stat_get(arena, "resident");
+        stats->mapped += arena_stat_get(arena, "mapped");
+        stats->retained += arena_stat_get(arena, "retained");
+    }
+    if (kind->extent_cache) {
+        pthread_mutex_lock(&kind->extent_cache->lock);
+        stats->retained += kind->extent_cache->size;
+        pthread_mutex_unlock(&kind->extent_cache->lock);
+    }
+    thread_partition_sum(kind->partition, &stats->nmalloc, &stats->nfree);
+    return 0;
 }
 
+MEMKIND_EXPORT int memkind_get_stats(struct memkind *kind,
+                                     memkind_stats_t *stats)
+{
+    pthread_once(&kind->init_once, kind->ops->init_once);
 
-void *arena_extent_alloc(extent_hooks_t *extent_hooks,
-                         void *new_addr,
-                         size_t size,
-                         size_t alignment,
-                         bool *zero,
-                         bool *commit,
-                         unsigned arena_ind)
+    return memkind_arena_stats(kind, stats);
+}
+
+static void *extent_alloc(struct memkind *kind, void *new_addr, size_t size,
+                          size_t alignment, bool *zero, bool *commit,
+                          unsigned node)
 {
     int err;
     void *addr = NULL;
 
-    struct memkind *kind = get_kind_by_arena(arena_ind);
-
     err = memkind_check_available(kind);
     if (err) {
         return NULL;
     }
 
+    if (kind->extent_cache && new_addr == NULL) {
+        addr = extent_cache_get(kind->extent_cache, size, alignment, node);
+        if (addr) {
+            *zero = !memkind_hog_memory;
+            *commit = true;
+            return addr;
+        }
+    }
+
+    if (kind->region_pool && new_addr == NULL) {
+        addr = region_alloc(kind, size, alignment);
+        if (addr) {
+            *zero = true;
+            *commit = true;
+            return addr;
+        }
+    }
+
     addr = kind_mmap(kind, new_addr, size);
     if (addr == MAP_FAILED) {
         return NULL;
@@ -207,6 +1146,25 @@ void *arena_extent_alloc(extent_hooks_t *extent_hooks,
     return addr;
 }
 
+void *arena_extent_alloc(extent_hooks_t *extent_hooks,
+                         void *new_addr,
+                         size_t size,
+                         size_t alignment,
+                         bool *zero,
+                         bool *commit,
+                         unsigned arena_ind)
+{
+    struct memkind *kind = get_kind_by_arena(arena_ind);
+    void *addr;
+
+    // extents of an arena of a node set are bound according to that node
+    extent_node = arena_node_g[arena_ind];
+    addr = extent_alloc(kind, new_addr, size, alignment, zero, commit,
+                        extent_node);
+    extent_node = 0;
+    return addr;
+}
+
 void *arena_extent_alloc_hugetlb(extent_hooks_t *extent_hooks,
                                  void *new_addr,
                                  size_t size,
@@ -227,7 +1185,13 @@ bool arena_extent_dalloc(extent_hooks_t *extent_hooks,
                          bool committed,
                          unsigned arena_ind)
 {
-    return true;
+    struct memkind *kind = get_kind_by_arena(arena_ind);
+
+    if (!kind->extent_cache) {
+        return true;
+    }
+    return extent_cache_put(kind->extent_cache, addr, size,
+                            arena_node_g[arena_ind]);
 }
 
 bool arena_extent_commit(extent_hooks_t *extent_hooks,
@@ -250,12 +1214,35 @@ bool arena_extent_decommit(extent_hooks_t *extent_hooks,
     return true;
 }
 
-bool arena_extent_purge(extent_hooks_t *extent_hooks,
-                        void *addr,
-                        size_t size,
-                        size_t offset,
-                        size_t length,
-                        unsigned arena_ind)
+bool arena_extent_purge_lazy(extent_hooks_t *extent_hooks,
+                             void *addr,
+                             size_t size,
+                             size_t offset,
+                             size_t length,
+                             unsigned arena_ind)
+{
+    struct memkind *kind = get_kind_by_arena(arena_ind);
+
+    if (memkind_hog_memory || kind->purge != MEMKIND_PURGE_LAZY ||
+        madvise_free_unsupported) {
+        return true;
+    }
+    // pages stay mapped until the kernel needs them, rewriting them is free
+    if (madvise(addr + offset, length, MADV_FREE)) {
+        if (errno == EINVAL) {
+            madvise_free_unsupported = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool arena_extent_purge_forced(extent_hooks_t *extent_hooks,
+                               void *addr,
+                               size_t size,
+                               size_t offset,
+                               size_t length,
+                               unsigned arena_ind)
 {
     int err;
 
@@ -294,17 +1281,19 @@ extent_hooks_t arena_extent_hooks = {
     .dalloc = arena_extent_dalloc,
     .commit = arena_extent_commit,
     .decommit = arena_extent_decommit,
-    .purge_lazy = arena_extent_purge,
+    .purge_lazy = arena_extent_purge_lazy,
+    .purge_forced = arena_extent_purge_forced,
     .split = arena_extent_split,
     .merge = arena_extent_merge
 };
 
+// MADV_FREE is not supported for huge pages
 extent_hooks_t arena_extent_hooks_hugetlb = {
     .alloc = arena_extent_alloc_hugetlb,
     .dalloc = arena_extent_dalloc,
     .commit = arena_extent_commit,
     .decommit = arena_extent_decommit,
-    .purge_lazy = arena_extent_purge,
+    .purge_forced = arena_extent_purge_forced,
     .split = arena_extent_split,
     .merge = arena_extent_merge
 };
@@ -314,18 +1303,123 @@ extent_hooks_t* get_extent_hooks_by_kind(struct memkind *kind)
     if (kind == MEMKIND_HUGETLB
         || kind == MEMKIND_HBW_HUGETLB
         || kind == MEMKIND_HBW_ALL_HUGETLB
-        || kind == MEMKIND_HBW_PREFERRED_HUGETLB) {
+        || kind == MEMKIND_HBW_PREFERRED_HUGETLB
+        // kinds composed by memkind_create_kind() with 2MB pages
+        || kind->ops->get_mmap_flags == memkind_hugetlb_get_mmap_flags) {
         return &arena_extent_hooks_hugetlb;
     } else {
         return &arena_extent_hooks;
     }
 }
 
+/*
+ * Creates arena of slot of kind unless another thread did it first.
+ * Slots are published with release semantics once hooks are set, so
+ * readers of kind->arena_map do not need the lock.
+ */
+static inline unsigned arena_node_slots(struct memkind *kind)
+{
+    return kind->arena_map_len > arena_node_num ?
+           kind->arena_map_len / arena_node_num : 1;
+}
+
+static int arena_slot_create(struct memkind *kind, unsigned slot,
+                             unsigned *arena)
+{
+    int err = 0;
+    size_t unsigned_size = sizeof(unsigned int);
+    unsigned arena_index;
+    char cmd[64];
+
+    pthread_mutex_lock(&arena_registry_write_lock);
+    arena_index = __atomic_load_n(&kind->arena_map[slot], __ATOMIC_ACQUIRE);
+    if (arena_index) {
+        goto exit;
+    }
+    err = jemk_mallctl("arenas.create", (void*)&arena_index, &unsigned_size, NULL,
+                       0);
+    if(err) {
+        log_err("Could not create arena.");
+        err = MEMKIND_ERROR_ARENAS_CREATE;
+        goto exit;
+    }
+    arena_registry_g[arena_index] = kind;
+    // the arena keeps serving its node even if selection changes later
+    arena_node_g[arena_index] = 0;
+    if (kind->arena_select == MEMKIND_ARENA_SELECT_NODE &&
+        kind->arena_map_len >= arena_node_num) {
+        arena_node_g[arena_index] = slot / arena_node_slots(kind) + 1;
+    }
+    //setup extent_hooks for newly created arena
+    snprintf(cmd, sizeof(cmd), "arena.%u.extent_hooks", arena_index);
+    err = jemk_mallctl(cmd, NULL, NULL, (void*)&kind->arena_hooks,
+                       sizeof(extent_hooks_t*));
+    if(err) {
+        log_err("Could not set extent hooks of arena.");
+        err = MEMKIND_ERROR_ARENAS_CREATE;
+        snprintf(cmd, sizeof(cmd), "arena.%u.destroy", arena_index);
+        jemk_mallctl(cmd, NULL, NULL, NULL, 0);
+        arena_registry_g[arena_index] = NULL;
+        goto exit;
+    }
+    err = arena_set_decay(arena_index, kind->dirty_decay_ms,
+                          kind->muzzy_decay_ms);
+    if(err) {
+        log_err("Could not set decay time of arena.");
+        snprintf(cmd, sizeof(cmd), "arena.%u.destroy", arena_index);
+        jemk_mallctl(cmd, NULL, NULL, NULL, 0);
+        arena_registry_g[arena_index] = NULL;
+        goto exit;
+    }
+    if (arena_index > arena_registry_max) {
+        __atomic_store_n(&arena_registry_max, arena_index, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&kind->arena_map[slot], arena_index, __ATOMIC_RELEASE);
+
+exit:
+    pthread_mutex_unlock(&arena_registry_write_lock);
+    *arena = arena_index;
+    return err;
+}
+
+static inline int arena_slot_get(struct memkind *kind, unsigned slot,
+                                 unsigned *arena)
+{
+    *arena = __atomic_load_n(&kind->arena_map[slot], __ATOMIC_ACQUIRE);
+    if (MEMKIND_LIKELY(*arena)) {
+        return 0;
+    }
+    return arena_slot_create(kind, slot, arena);
+}
+
+MEMKIND_EXPORT int memkind_set_decay(struct memkind *kind,
+                                     ssize_t dirty_decay_ms,
+                                     ssize_t muzzy_decay_ms)
+{
+    int err = 0;
+    unsigned i;
+
+    pthread_once(&kind->init_once, kind->ops->init_once);
+
+    if (kind->arena_map_len == 0 || dirty_decay_ms < -1 || muzzy_decay_ms < -1) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    pthread_mutex_lock(&arena_registry_write_lock);
+    kind->dirty_decay_ms = dirty_decay_ms;
+    kind->muzzy_decay_ms = muzzy_decay_ms;
+    for (i = 0; i < kind->arena_map_len && !err; ++i) {
+        if (kind->arena_map[i]) {
+            err = arena_set_decay(kind->arena_map[i], dirty_decay_ms, muzzy_decay_ms);
+        }
+    }
+    pthread_mutex_unlock(&arena_registry_write_lock);
+    return err;
+}
+
 MEMKIND_EXPORT int memkind_arena_create_map(struct memkind *kind,
                                             extent_hooks_t *hooks)
 {
     int err = 0;
-    size_t unsigned_size = sizeof(unsigned int);
 
     pthread_once(&arena_config_once, arena_config_init);
     if(arena_init_status) {
@@ -336,41 +1430,60 @@ MEMKIND_EXPORT int memkind_arena_create_map(struct memkind *kind,
     if(err) {
         return err;
     }
+    err = memkind_set_tcache_max_env(kind);
+    if(err) {
+        return err;
+    }
+    err = memkind_set_arena_select_env(kind);
+    if(err) {
+        return err;
+    }
+    err = memkind_set_decay_env(kind);
+    if(err) {
+        return err;
+    }
+    err = memkind_set_purge_env(kind);
+    if(err) {
+        return err;
+    }
 #ifdef MEMKIND_TLS
     if (kind->ops->get_arena == memkind_thread_get_arena) {
         pthread_key_create(&(kind->arena_key), jemk_free);
     }
 #endif
 
-    pthread_mutex_lock(&arena_registry_write_lock);
-    unsigned i = 0;
-    kind->arena_zero = UINT_MAX;
-    for(i = 0; i<kind->arena_map_len; i++) {
-        //create new arena with consecutive index
-        unsigned arena_index;
-        err = jemk_mallctl("arenas.create", (void*)&arena_index, &unsigned_size, NULL,
-                           0);
-        if(err) {
-            log_err("Could not create arena.");
-            err = MEMKIND_ERROR_ARENAS_CREATE;
-            goto exit;
-        }
-        //store arena with lowest index (arenas could be created in descending/ascending order)
-        if(kind->arena_zero > arena_index) {
-            kind->arena_zero = arena_index;
-        }
-        //setup extent_hooks for newly created arena
-        char cmd[64];
-        snprintf(cmd, sizeof(cmd), "arena.%u.extent_hooks", arena_index);
-        err = jemk_mallctl(cmd, NULL, NULL, (void*)&hooks, sizeof(extent_hooks_t*));
-        if(err) {
-            goto exit;
+    if (kind->arena_map_len == 0) {
+        return 0;
+    }
+    kind->arena_map = jemk_calloc(kind->arena_map_len, sizeof(unsigned int));
+    if (!kind->arena_map) {
+        log_err("jemk_calloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+    kind->arena_hooks = hooks;
+
+    if ((hooks == &arena_extent_hooks || hooks == &arena_extent_hooks_hugetlb) &&
+        kind->ops->mmap == NULL) {
+        err = extent_cache_create(kind);
+        if (!err && hooks == &arena_extent_hooks) {
+            err = region_pool_create(kind);
+        }
+        if (err) {
+            extent_cache_destroy(kind);
+            jemk_free(kind->arena_map);
+            kind->arena_map = NULL;
+            return err;
         }
-        arena_registry_g[arena_index] = kind;
     }
 
-exit:
-    pthread_mutex_unlock(&arena_registry_write_lock);
+    // other arenas are created on first use of their slot
+    err = arena_slot_create(kind, 0, &kind->arena_zero);
+    if (err) {
+        region_pool_destroy(kind);
+        extent_cache_destroy(kind);
+        jemk_free(kind->arena_map);
+        kind->arena_map = NULL;
+    }
     return err;
 }
 
@@ -391,11 +1504,21 @@ MEMKIND_EXPORT int memkind_arena_destroy(struct memkind *kind)
     char cmd[128];
     unsigned int i;
 
-    if (kind->arena_map_len) {
+    tcache_destroy_partition(kind->partition);
+
+    if (kind->arena_map) {
         for (i = 0; i < kind->arena_map_len; ++i) {
-            snprintf(cmd, 128, "arena.%u.destroy", kind->arena_zero + i);
+            if (kind->arena_map[i] == 0) {
+                continue;
+            }
+            snprintf(cmd, 128, "arena.%u.destroy", kind->arena_map[i]);
             jemk_mallctl(cmd, NULL, NULL, NULL, 0);
         }
+        jemk_free(kind->arena_map);
+        kind->arena_map = NULL;
+        // destroyed arenas released their extents to the cache
+        extent_cache_destroy(kind);
+        region_pool_destroy(kind);
 #ifdef MEMKIND_TLS
         if (kind->ops->get_arena == memkind_thread_get_arena) {
             pthread_key_delete(kind->arena_key);
@@ -412,72 +1535,311 @@ int memkind_arena_finalize(struct memkind *kind)
     return memkind_arena_destroy(kind);
 }
 
-// max allocation size to be cached by tcache mechanism
-// should be aligned with jemalloc opt.lg_tcache_max
-#define TCACHE_MAX (1<<12)
+/*
+ * Per-thread map from kind partition to jemalloc tcache index and counters
+ * of the thread. The map grows with the partitions used by the thread, so
+ * dynamic kinds get tcaches too. All maps are linked together, which lets
+ * memkind_arena_destroy() drop the tcaches of a destroyed kind in every
+ * thread before its arenas go away and the partition is handed to a new
+ * kind, and lets memkind_get_stats() sum up counters of all threads.
+ */
+struct thread_partition {
+    unsigned tcache; // 0 until the thread uses tcache of the partition
+    int node;        // NUMA node + 1 the tcache was used on, 0 until known
+    size_t nmalloc;  // written by the owning thread only
+    size_t nfree;
+};
+
+struct tcache_map {
+    struct tcache_map *next;
+    struct tcache_map *prev;
+    unsigned len;
+    struct thread_partition *part;
+};
+
+static struct tcache_map *tcache_map_list;
+static pthread_mutex_t tcache_map_lock = PTHREAD_MUTEX_INITIALIZER;
+// counters of threads which have exited
+static size_t exited_nmalloc[MEMKIND_MAX_KIND];
+static size_t exited_nfree[MEMKIND_MAX_KIND];
+
+static void tcache_destroy(unsigned *tcache)
+{
+    // tcache.destroy flushes cached objects back to their arenas first
+    jemk_mallctl("tcache.destroy", NULL, NULL, (void *)tcache,
+                 sizeof(unsigned));
+    *tcache = 0;
+}
 
 static void tcache_finalize(void* args)
 {
-    int i;
-    unsigned *tcache_map = args;
-    for(i = 0; i<MEMKIND_NUM_BASE_KIND; i++) {
-        if(tcache_map[i] != 0) {
-            jemk_mallctl("tcache.destroy", NULL, NULL, (void*)&tcache_map[i],
-                         sizeof(unsigned));
+    unsigned i;
+    struct tcache_map *map = args;
+
+    if (pthread_mutex_lock(&tcache_map_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    for(i = 0; i < map->len; i++) {
+        if(map->part[i].tcache != 0) {
+            tcache_destroy(&map->part[i].tcache);
         }
+        exited_nmalloc[i] += map->part[i].nmalloc;
+        exited_nfree[i] += map->part[i].nfree;
+    }
+    if (map->prev) {
+        map->prev->next = map->next;
+    } else {
+        tcache_map_list = map->next;
     }
+    if (map->next) {
+        map->next->prev = map->prev;
+    }
+    if (pthread_mutex_unlock(&tcache_map_lock) != 0)
+        assert(0 && "failed to release mutex");
+
+    jemk_free(map->part);
+    jemk_free(map);
 }
 
-static inline int get_tcache_flag(unsigned partition, size_t size)
+static void tcache_destroy_partition(unsigned partition)
 {
+    struct tcache_map *map;
 
-    // do not cache allocation larger than tcache_max nor those comming from non-static kinds
-    if(size > TCACHE_MAX || partition >= MEMKIND_NUM_BASE_KIND) {
-        return MALLOCX_TCACHE_NONE;
+    if (partition >= MEMKIND_MAX_KIND) {
+        return;
+    }
+    if (pthread_mutex_lock(&tcache_map_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    for (map = tcache_map_list; map; map = map->next) {
+        if (partition < map->len) {
+            if (map->part[partition].tcache != 0) {
+                tcache_destroy(&map->part[partition].tcache);
+            }
+            __atomic_store_n(&map->part[partition].nmalloc, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&map->part[partition].nfree, 0, __ATOMIC_RELAXED);
+        }
     }
+    exited_nmalloc[partition] = 0;
+    exited_nfree[partition] = 0;
+    if (pthread_mutex_unlock(&tcache_map_lock) != 0)
+        assert(0 && "failed to release mutex");
+}
 
-    unsigned *tcache_map = pthread_getspecific(tcache_key);
-    if(tcache_map == NULL) {
-        tcache_map = jemk_calloc(MEMKIND_NUM_BASE_KIND, sizeof(unsigned));
-        if(tcache_map == NULL) {
-            return MALLOCX_TCACHE_NONE;
+static void thread_partition_sum(unsigned partition, size_t *nmalloc,
+                                 size_t *nfree)
+{
+    struct tcache_map *map;
+
+    if (partition >= MEMKIND_MAX_KIND) {
+        return;
+    }
+    if (pthread_mutex_lock(&tcache_map_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    *nmalloc = exited_nmalloc[partition];
+    *nfree = exited_nfree[partition];
+    for (map = tcache_map_list; map; map = map->next) {
+        if (partition < map->len) {
+            *nmalloc += __atomic_load_n(&map->part[partition].nmalloc,
+                                        __ATOMIC_RELAXED);
+            *nfree += __atomic_load_n(&map->part[partition].nfree,
+                                      __ATOMIC_RELAXED);
+        }
+    }
+    if (pthread_mutex_unlock(&tcache_map_lock) != 0)
+        assert(0 && "failed to release mutex");
+}
+
+static struct tcache_map *tcache_map_create(void)
+{
+    struct tcache_map *map = jemk_calloc(1, sizeof(struct tcache_map));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->part = jemk_calloc(MEMKIND_NUM_BASE_KIND, sizeof(struct thread_partition));
+    if (map->part == NULL) {
+        jemk_free(map);
+        return NULL;
+    }
+    map->len = MEMKIND_NUM_BASE_KIND;
+
+    if (pthread_mutex_lock(&tcache_map_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    map->next = tcache_map_list;
+    if (tcache_map_list) {
+        tcache_map_list->prev = map;
+    }
+    tcache_map_list = map;
+    if (pthread_mutex_unlock(&tcache_map_lock) != 0)
+        assert(0 && "failed to release mutex");
+
+    pthread_setspecific(tcache_key, (void*)map);
+    return map;
+}
+
+static int tcache_map_grow(struct tcache_map *map, unsigned partition)
+{
+    unsigned len = map->len * 2;
+    struct thread_partition *part;
+
+    while (len <= partition) {
+        len *= 2;
+    }
+    if (len > MEMKIND_MAX_KIND) {
+        len = MEMKIND_MAX_KIND;
+    }
+
+    // other threads may zero entries of this map in tcache_destroy_partition()
+    if (pthread_mutex_lock(&tcache_map_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    part = jemk_realloc(map->part, len * sizeof(struct thread_partition));
+    if (part) {
+        memset(part + map->len, 0,
+               (len - map->len) * sizeof(struct thread_partition));
+        map->part = part;
+        map->len = len;
+    }
+    if (pthread_mutex_unlock(&tcache_map_lock) != 0)
+        assert(0 && "failed to release mutex");
+
+    return part ? 0 : -1;
+}
+
+// Returns state of partition of kind private to the calling thread.
+static inline struct thread_partition *get_thread_partition(
+    struct memkind *kind)
+{
+    unsigned partition = kind->partition;
+
+    if (MEMKIND_UNLIKELY(partition >= MEMKIND_MAX_KIND)) {
+        return NULL;
+    }
+
+    struct tcache_map *map = pthread_getspecific(tcache_key);
+    if(MEMKIND_UNLIKELY(map == NULL)) {
+        map = tcache_map_create();
+        if(map == NULL) {
+            return NULL;
+        }
+    }
+
+    if(MEMKIND_UNLIKELY(partition >= map->len)) {
+        if(tcache_map_grow(map, partition)) {
+            return NULL;
         }
-        pthread_setspecific(tcache_key, (void*)tcache_map);
+    }
+    return &map->part[partition];
+}
+
+static inline void thread_counter_inc(size_t *counter)
+{
+    // only the owning thread writes, readers may see a stale value
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+}
+
+/*
+ * Objects cached by the thread come from arenas of the node it ran on, so
+ * with arenas selected by node the tcache is flushed when the thread
+ * migrates to another node, otherwise small allocations would still be
+ * served from the memory of the old node.
+ */
+static inline void tcache_node_check(struct thread_partition *part)
+{
+    int cpu = sched_getcpu();
+    int node = (cpu >= 0 && cpu < cpu_node_len ? cpu_node_g[cpu] : 0) + 1;
+
+    if (MEMKIND_UNLIKELY(part->node != node)) {
+        if (part->node != 0) {
+            jemk_mallctl("tcache.flush", NULL, NULL, (void *)&part->tcache,
+                         sizeof(unsigned));
+        }
+        part->node = node;
+    }
+}
+
+static inline int get_tcache_flag(struct memkind *kind,
+                                  struct thread_partition *part, size_t size)
+{
+    // do not cache allocation larger than tcache_max of the kind
+    if(size > kind->tcache_max || kind->tcache_max == 0 || part == NULL) {
+        return MALLOCX_TCACHE_NONE;
     }
 
-    if(MEMKIND_UNLIKELY(tcache_map[partition] == 0)) {
+    if(MEMKIND_UNLIKELY(part->tcache == 0)) {
         size_t unsigned_size = sizeof(unsigned);
-        int err = jemk_mallctl("tcache.create", (void*)&tcache_map[partition],
+        unsigned tcache;
+        int err = jemk_mallctl("tcache.create", (void*)&tcache,
                                &unsigned_size, NULL, 0);
         if(err) {
             log_err("Could not acquire tcache, err=%d", err);
             return MALLOCX_TCACHE_NONE;
         }
+        part->tcache = tcache;
+    }
+    if (kind->arena_select == MEMKIND_ARENA_SELECT_NODE) {
+        tcache_node_check(part);
     }
-    return MALLOCX_TCACHE(tcache_map[partition]);
+    return MALLOCX_TCACHE(part->tcache);
 }
 
-MEMKIND_EXPORT void *memkind_arena_malloc(struct memkind *kind, size_t size)
+static inline void *arena_malloc(struct memkind *kind,
+                                 struct thread_partition *part, size_t size)
 {
     void *result = NULL;
-    int err = 0;
     unsigned int arena;
 
-    err = kind->ops->get_arena(kind, &arena, size);
-    if (MEMKIND_LIKELY(!err)) {
+    if (MEMKIND_LIKELY(!kind->ops->get_arena(kind, &arena, size))) {
         result = jemk_mallocx_check(size,
-                                    MALLOCX_ARENA(arena) | get_tcache_flag(kind->partition, size));
+                                    MALLOCX_ARENA(arena) | get_tcache_flag(kind, part, size));
+    }
+    return result;
+}
+
+MEMKIND_EXPORT void *memkind_arena_malloc(struct memkind *kind, size_t size)
+{
+    struct thread_partition *part = get_thread_partition(kind);
+    void *result = arena_malloc(kind, part, size);
+
+    if (MEMKIND_LIKELY(result && part)) {
+        thread_counter_inc(&part->nmalloc);
     }
     return result;
 }
 
 MEMKIND_EXPORT void memkind_arena_free(struct memkind *kind, void *ptr)
+{
+    if (!kind) {
+        // kind of ptr is unknown, the free is not counted; objects above the
+        // default tcache_max may belong to other kinds, they must not stay in
+        // the implicit thread cache, which holds objects of up to TCACHE_MAX_LIMIT
+        if (ptr) {
+            jemk_dallocx(ptr, jemk_malloc_usable_size(ptr) > TCACHE_MAX ?
+                         MALLOCX_TCACHE_NONE : 0);
+        }
+    } else if (ptr) {
+        struct thread_partition *part = get_thread_partition(kind);
+        // jemalloc frees memory to its owning arena, no need to pick one
+        jemk_dallocx(ptr, get_tcache_flag(kind, part, 0));
+        if (MEMKIND_LIKELY(part)) {
+            thread_counter_inc(&part->nfree);
+        }
+    }
+}
+
+/*
+ * memkind_arena_malloc() and memkind_arena_free() without per-thread
+ * counters, the baseline for measuring their cost.
+ */
+MEMKIND_EXPORT void *memkind_arena_malloc_uncounted(struct memkind *kind,
+                                                    size_t size)
+{
+    return arena_malloc(kind, get_thread_partition(kind), size);
+}
+
+MEMKIND_EXPORT void memkind_arena_free_uncounted(struct memkind *kind,
+                                                 void *ptr)
 {
     if (ptr) {
-        unsigned int arena;
-        kind->ops->get_arena(kind, &arena, 0);
-        assert(arena != 0);
-        jemk_dallocx(ptr, MALLOCX_ARENA(arena) | get_tcache_flag(kind->partition, 0));
+        jemk_dallocx(ptr, get_tcache_flag(kind, get_thread_partition(kind), 0));
     }
 }
 
@@ -491,14 +1853,18 @@ MEMKIND_EXPORT void *memkind_arena_realloc(struct memkind *kind, void *ptr,
         memkind_free(kind, ptr);
         ptr = NULL;
     } else {
+        struct thread_partition *part = get_thread_partition(kind);
         err = kind->ops->get_arena(kind, &arena, size);
         if (MEMKIND_LIKELY(!err)) {
             if (ptr == NULL) {
                 ptr = jemk_mallocx_check(size,
-                                         MALLOCX_ARENA(arena) | get_tcache_flag(kind->partition, size));
+                                         MALLOCX_ARENA(arena) | get_tcache_flag(kind, part, size));
+                if (ptr && part) {
+                    thread_counter_inc(&part->nmalloc);
+                }
             } else {
                 ptr = jemk_rallocx_check(ptr, size,
-                                         MALLOCX_ARENA(arena) | get_tcache_flag(kind->partition, size));
+                                         MALLOCX_ARENA(arena) | get_tcache_flag(kind, part, size));
             }
         }
     }
@@ -508,6 +1874,7 @@ MEMKIND_EXPORT void *memkind_arena_realloc(struct memkind *kind, void *ptr,
 MEMKIND_EXPORT void *memkind_arena_calloc(struct memkind *kind, size_t num,
                                           size_t size)
 {
+    struct thread_partition *part = get_thread_partition(kind);
     void *result = NULL;
     int err = 0;
     unsigned int arena;
@@ -515,7 +1882,10 @@ MEMKIND_EXPORT void *memkind_arena_calloc(struct memkind *kind, size_t num,
     err = kind->ops->get_arena(kind, &arena, size);
     if (MEMKIND_LIKELY(!err)) {
         result = jemk_mallocx_check(num * size,
-                                    MALLOCX_ARENA(arena) | MALLOCX_ZERO | get_tcache_flag(kind->partition, size));
+                                    MALLOCX_ARENA(arena) | MALLOCX_ZERO | get_tcache_flag(kind, part, size));
+    }
+    if (MEMKIND_LIKELY(result && part)) {
+        thread_counter_inc(&part->nmalloc);
     }
     return result;
 }
@@ -524,6 +1894,7 @@ MEMKIND_EXPORT int memkind_arena_posix_memalign(struct memkind *kind,
                                                 void **memptr, size_t alignment,
                                                 size_t size)
 {
+    struct thread_partition *part = get_thread_partition(kind);
     int err = 0;
     unsigned int arena;
     int errno_before;
@@ -539,9 +1910,12 @@ MEMKIND_EXPORT int memkind_arena_posix_memalign(struct memkind *kind,
         errno_before = errno;
         *memptr = jemk_mallocx_check(size,
                                      MALLOCX_ALIGN(alignment) | MALLOCX_ARENA(arena) | get_tcache_flag(
-                                         kind->partition, size));
+                                         kind, part, size));
         errno = errno_before;
         err = *memptr ? 0 : ENOMEM;
+        if (*memptr && part) {
+            thread_counter_inc(&part->nmalloc);
+        }
     }
     return err;
 }
@@ -554,8 +1928,7 @@ MEMKIND_EXPORT int memkind_bijective_get_arena(struct memkind *kind,
 }
 
 #ifdef MEMKIND_TLS
-MEMKIND_EXPORT int memkind_thread_get_arena(struct memkind *kind,
-                                            unsigned int *arena, size_t size)
+static int thread_hash_get_arena(struct memkind *kind, unsigned int *arena)
 {
     int err = 0;
     unsigned int *arena_tsd;
@@ -574,8 +1947,15 @@ MEMKIND_EXPORT int memkind_thread_get_arena(struct memkind *kind,
                   MEMKIND_ERROR_RUNTIME : 0;
         }
     }
-    *arena = kind->arena_zero + *arena_tsd;
-    return err;
+    if (MEMKIND_UNLIKELY(err)) {
+        return err;
+    }
+    return arena_slot_get(kind, *arena_tsd, arena);
+}
+
+static inline unsigned thread_hash(void)
+{
+    return _mm_crc32_u64(0, (uint64_t)pthread_self());
 }
 
 #else
@@ -594,18 +1974,57 @@ static uintptr_t get_fs_base()
     return fs_base;
 }
 
-MEMKIND_EXPORT int memkind_thread_get_arena(struct memkind *kind,
-                                            unsigned int *arena, size_t size)
+static int thread_hash_get_arena(struct memkind *kind, unsigned int *arena)
 {
     unsigned int arena_idx;
     // it's likely that each thread control block lies on diffrent page
     // so we extracting page number with >> 12 to improve hashing
     arena_idx = (get_fs_base() >> 12) & kind->arena_map_mask;
-    *arena = kind->arena_zero + arena_idx;
-    return 0;
+    return arena_slot_get(kind, arena_idx, arena);
+}
+
+static inline unsigned thread_hash(void)
+{
+    return get_fs_base() >> 12;
 }
 #endif //MEMKIND_TLS
 
+// ordinal of the thread + 1 in order of first round-robin arena selection
+static __thread unsigned int thread_ordinal MEMKIND_TLS_MODEL;
+static unsigned int thread_ordinal_next;
+
+MEMKIND_EXPORT int memkind_thread_get_arena(struct memkind *kind,
+                                            unsigned int *arena, size_t size)
+{
+    int cpu;
+    unsigned slots;
+
+    switch (kind->arena_select) {
+        case MEMKIND_ARENA_SELECT_CPU:
+            // sched_getcpu() reads the CPU from rseq area or vDSO
+            cpu = sched_getcpu();
+            return arena_slot_get(kind, (cpu < 0 ? 0 : cpu) & kind->arena_map_mask,
+                                  arena);
+        case MEMKIND_ARENA_SELECT_ROUND_ROBIN:
+            if (MEMKIND_UNLIKELY(thread_ordinal == 0)) {
+                thread_ordinal = __atomic_add_fetch(&thread_ordinal_next, 1,
+                                                    __ATOMIC_RELAXED);
+            }
+            return arena_slot_get(kind, (thread_ordinal - 1) & kind->arena_map_mask,
+                                  arena);
+        case MEMKIND_ARENA_SELECT_NODE:
+            // threads of a node hash to arenas of its set, see arena_node_slots()
+            cpu = sched_getcpu();
+            slots = arena_node_slots(kind);
+            return arena_slot_get(kind, ((cpu >= 0 && cpu < cpu_node_len ?
+                                          cpu_node_g[cpu] * slots : 0) +
+                                         (thread_hash() & (slots - 1))) &
+                                  kind->arena_map_mask, arena);
+        default:
+            return thread_hash_get_arena(kind, arena);
+    }
+}
+
 static void *jemk_mallocx_check(size_t size, int flags)
 {
     /*
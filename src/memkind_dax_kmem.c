@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind/internal/memkind_dax_kmem.h>
+#include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_default.h>
+#include <memkind/internal/memkind_arena.h>
+#include <memkind/internal/memkind_private.h>
+#include <memkind/internal/memkind_log.h>
+#include <memkind/internal/heap_manager.h>
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Device DAX regions reconfigured with "daxctl reconfigure-device
+ * --mode=system-ram" are bound to the kmem driver and their memory is
+ * onlined to target_node, a NUMA node without CPUs.
+ */
+
+struct dax_kmem_nodes_t {
+    struct memkind_closest_numanode_t closest;
+    struct bitmask *all_nodes;
+};
+
+static struct dax_kmem_nodes_t dax_kmem_nodes_g;
+static pthread_once_t dax_kmem_nodes_once_g = PTHREAD_ONCE_INIT;
+
+static bool dax_device_is_kmem(const char *device_path)
+{
+    char path[PATH_MAX];
+    char driver[PATH_MAX];
+    const char *name;
+    ssize_t len;
+
+    if (snprintf(path, sizeof(path), "%s/driver", device_path) >=
+        (int)sizeof(path)) {
+        return false;
+    }
+    len = readlink(path, driver, sizeof(driver) - 1);
+    if (len < 0) {
+        return false;
+    }
+    driver[len] = '\0';
+    name = strrchr(driver, '/');
+    name = name ? name + 1 : driver;
+    return strcmp(name, "kmem") == 0;
+}
+
+static int dax_device_target_node(const char *device_path)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+    int node = -1;
+
+    if (snprintf(path, sizeof(path), "%s/target_node", device_path) >=
+        (int)sizeof(path)) {
+        return -1;
+    }
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    if (fscanf(fp, "%d", &node) != 1) {
+        node = -1;
+    }
+    fclose(fp);
+    return node;
+}
+
+static void dax_kmem_nodes_from_sysfs(struct bitmask *nodes)
+{
+    char dir_path[PATH_MAX];
+    char device_path[PATH_MAX];
+    struct dirent *entry;
+    DIR *dir;
+    int node;
+
+    snprintf(dir_path, sizeof(dir_path), "%s/bus/dax/devices",
+             memkind_sysfs_root());
+    dir = opendir(dir_path);
+    if (!dir) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        if (snprintf(device_path, sizeof(device_path), "%s/%s", dir_path,
+                     entry->d_name) >= (int)sizeof(device_path) ||
+            !dax_device_is_kmem(device_path)) {
+            continue;
+        }
+        node = dax_device_target_node(device_path);
+        if (node >= 0 && (unsigned)node < nodes->size) {
+            numa_bitmask_setbit(nodes, node);
+        }
+    }
+    closedir(dir);
+}
+
+MEMKIND_EXPORT int memkind_dax_kmem_get_nodemask(struct bitmask *nodes)
+{
+    char *nodes_env = getenv("MEMKIND_DAX_KMEM_NODES");
+
+    numa_bitmask_clearall(nodes);
+    if (nodes_env) {
+        struct bitmask *env_nodes = numa_parse_nodestring(nodes_env);
+        if (!env_nodes) {
+            log_err("Wrong MEMKIND_DAX_KMEM_NODES environment value.");
+            return MEMKIND_ERROR_ENVIRON;
+        }
+        log_info("Environment variable MEMKIND_DAX_KMEM_NODES detected: %s.",
+                 nodes_env);
+        copy_bitmask_to_bitmask(env_nodes, nodes);
+        numa_bitmask_free(env_nodes);
+    } else {
+        dax_kmem_nodes_from_sysfs(nodes);
+    }
+    return numa_bitmask_weight(nodes) ? 0 : MEMKIND_ERROR_UNAVAILABLE;
+}
+
+static int fill_dax_kmem_values(int *values, int values_len)
+{
+    struct bitmask *nodes = numa_allocate_nodemask();
+    int node, err = memkind_dax_kmem_get_nodemask(nodes);
+
+    for (node = 0; node < values_len; ++node) {
+        values[node] = numa_bitmask_isbitset(nodes, node);
+    }
+    numa_bitmask_free(nodes);
+    return err;
+}
+
+static void dax_kmem_nodes_init(void)
+{
+    struct dax_kmem_nodes_t *g = &dax_kmem_nodes_g;
+    unsigned node;
+
+    memkind_closest_numanode_init(&g->closest, fill_dax_kmem_values,
+                                  "DAX KMEM memory", true);
+    if (g->closest.init_err) {
+        return;
+    }
+    // all DAX KMEM nodes known to libnuma, not only the closest ones
+    g->all_nodes = numa_allocate_nodemask();
+    memkind_dax_kmem_get_nodemask(g->all_nodes);
+    for (node = 0; node < g->all_nodes->size; ++node) {
+        if (!numa_bitmask_isbitset(numa_nodes_ptr, node)) {
+            numa_bitmask_clearbit(g->all_nodes, node);
+        }
+    }
+}
+
+static int memkind_dax_kmem_check_available(struct memkind *kind)
+{
+    return kind->ops->get_mbind_nodemask(kind, NULL, 0);
+}
+
+static int memkind_dax_kmem_get_mbind_nodemask(struct memkind *kind,
+                                               unsigned long *nodemask,
+                                               unsigned long maxnode)
+{
+    pthread_once(&dax_kmem_nodes_once_g, dax_kmem_nodes_init);
+    return memkind_closest_numanode_get_mbind_nodemask(
+               &dax_kmem_nodes_g.closest, nodemask, maxnode);
+}
+
+static int memkind_dax_kmem_all_get_mbind_nodemask(struct memkind *kind,
+                                                   unsigned long *nodemask,
+                                                   unsigned long maxnode)
+{
+    struct dax_kmem_nodes_t *g = &dax_kmem_nodes_g;
+    struct bitmask nodemask_bm = {maxnode, nodemask};
+
+    pthread_once(&dax_kmem_nodes_once_g, dax_kmem_nodes_init);
+    if (MEMKIND_LIKELY(!g->closest.init_err && nodemask)) {
+        copy_bitmask_to_bitmask(g->all_nodes, &nodemask_bm);
+    }
+    return g->closest.init_err;
+}
+
+static void memkind_dax_kmem_init_once(void)
+{
+    memkind_init(MEMKIND_DAX_KMEM, true);
+}
+
+static void memkind_dax_kmem_all_init_once(void)
+{
+    memkind_init(MEMKIND_DAX_KMEM_ALL, true);
+}
+
+static void memkind_dax_kmem_preferred_init_once(void)
+{
+    memkind_init(MEMKIND_DAX_KMEM_PREFERRED, true);
+}
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_DAX_KMEM_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_default_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = heap_manager_free,
+    .check_available = memkind_dax_kmem_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_default_get_mbind_mode,
+    .get_mbind_nodemask = memkind_dax_kmem_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .init_once = memkind_dax_kmem_init_once,
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_DAX_KMEM_ALL_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_default_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = heap_manager_free,
+    .check_available = memkind_dax_kmem_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_default_get_mbind_mode,
+    .get_mbind_nodemask = memkind_dax_kmem_all_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .init_once = memkind_dax_kmem_all_init_once,
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_DAX_KMEM_PREFERRED_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_default_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = heap_manager_free,
+    .check_available = memkind_dax_kmem_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_preferred_get_mbind_mode,
+    .get_mbind_nodemask = memkind_dax_kmem_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .init_once = memkind_dax_kmem_preferred_init_once,
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
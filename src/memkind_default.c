@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <jemalloc/jemalloc.h>
 #include <stdint.h>
+#include <limits.h>
 
 #ifndef MADV_NOHUGEPAGE
 #define MADV_NOHUGEPAGE 15
@@ -49,6 +50,7 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_DEFAULT_OPS = {
     .free = memkind_default_free,
     .init_once = memkind_default_init_once,
     .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size,
     .finalize = memkind_default_destroy
 };
 
@@ -118,6 +120,16 @@ MEMKIND_EXPORT size_t memkind_default_malloc_usable_size(struct memkind *kind,
     return jemk_malloc_usable_size(ptr);
 }
 
+MEMKIND_EXPORT size_t memkind_default_good_size(struct memkind *kind,
+                                                size_t size)
+{
+    // size classes are the same in all arenas
+    if (MEMKIND_UNLIKELY(size_out_of_bounds(size) || size >= LLONG_MAX)) {
+        return 0;
+    }
+    return jemk_nallocx(size, 0);
+}
+
 MEMKIND_EXPORT void *memkind_default_mmap(struct memkind *kind, void *addr,
                                           size_t size)
 {
@@ -43,7 +43,7 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_GBTLB_OPS = {
     .calloc = memkind_arena_calloc,
     .posix_memalign = memkind_arena_posix_memalign,
     .realloc = memkind_arena_realloc,
-    .free = memkind_default_free,
+    .free = memkind_arena_free,
     .mmap = gbtlb_mmap,
     .check_available = memkind_hugetlb_check_available_2mb,
     .mbind = memkind_default_mbind,
@@ -52,7 +52,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_GBTLB_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_gbtlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_GBTLB_OPS = {
@@ -62,7 +64,7 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_GBTLB_OPS = {
     .calloc = memkind_arena_calloc,
     .posix_memalign = memkind_arena_posix_memalign,
     .realloc = memkind_arena_realloc,
-    .free = memkind_default_free,
+    .free = memkind_arena_free,
     .mmap = gbtlb_mmap,
     .check_available = memkind_hugetlb_check_available_2mb,
     .mbind = memkind_default_mbind,
@@ -71,7 +73,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_GBTLB_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_preferred_gbtlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_GBTLB_OPS = {
@@ -81,13 +85,15 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_GBTLB_OPS = {
     .calloc = memkind_arena_calloc,
     .posix_memalign = memkind_arena_posix_memalign,
     .realloc = memkind_arena_realloc,
-    .free = memkind_default_free,
+    .free = memkind_arena_free,
     .mmap = gbtlb_mmap,
     .check_available = memkind_hugetlb_check_available_2mb,
     .get_mmap_flags = memkind_hugetlb_get_mmap_flags,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_gbtlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 #define ONE_GB 1073741824ULL
@@ -23,6 +23,8 @@
  */
 
 #include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_dax_kmem.h>
 #include <memkind/internal/memkind_default.h>
 #include <memkind/internal/memkind_hugetlb.h>
 #include <memkind/internal/memkind_arena.h>
@@ -61,7 +63,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_ALL_OPS = {
@@ -79,7 +83,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_ALL_OPS = {
     .get_mbind_nodemask = memkind_hbw_all_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_all_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_HUGETLB_OPS = {
@@ -97,7 +103,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_HUGETLB_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_hugetlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_ALL_HUGETLB_OPS = {
@@ -115,7 +123,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_ALL_HUGETLB_OPS = {
     .get_mbind_nodemask = memkind_hbw_all_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_all_hugetlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_OPS = {
@@ -133,7 +143,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_preferred_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_HUGETLB_OPS = {
@@ -151,7 +163,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_PREFERRED_HUGETLB_OPS = {
     .get_mbind_nodemask = memkind_hbw_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_preferred_hugetlb_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_INTERLEAVE_OPS = {
@@ -170,7 +184,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_HBW_INTERLEAVE_OPS = {
     .get_mbind_nodemask = memkind_hbw_all_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_hbw_interleave_init_once,
-    .finalize = memkind_arena_finalize
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 struct numanode_bandwidth_t {
@@ -184,13 +200,7 @@ struct bandwidth_nodes_t {
     int *numanodes;
 };
 
-struct memkind_hbw_closest_numanode_t {
-    int init_err;
-    int num_cpu;
-    int *closest_numanode;
-};
-
-static struct memkind_hbw_closest_numanode_t memkind_hbw_closest_numanode_g;
+static struct memkind_closest_numanode_t memkind_hbw_closest_numanode_g;
 static pthread_once_t memkind_hbw_closest_numanode_once_g = PTHREAD_ONCE_INIT;
 
 static void memkind_hbw_closest_numanode_init(void);
@@ -200,7 +210,8 @@ static int create_bandwidth_nodes(int num_bandwidth, const int *bandwidth,
 
 static int set_closest_numanode(int num_unique,
                                 const struct bandwidth_nodes_t *bandwidth_nodes,
-                                int target_bandwidth, int num_cpunode, int *closest_numanode);
+                                int target_bandwidth, int num_cpunode, int *closest_numanode,
+                                nodemask_t *closest_nodemask);
 
 static int numanode_bandwidth_compare(const void *a, const void *b);
 
@@ -236,40 +247,85 @@ MEMKIND_EXPORT int memkind_hbw_get_mbind_nodemask(struct memkind *kind,
                                                   unsigned long *nodemask,
                                                   unsigned long maxnode)
 {
-    int cpu;
-    struct bitmask nodemask_bm = {maxnode, nodemask};
-    struct memkind_hbw_closest_numanode_t *g =
-            &memkind_hbw_closest_numanode_g;
     pthread_once(&memkind_hbw_closest_numanode_once_g,
                  memkind_hbw_closest_numanode_init);
+    return memkind_closest_numanode_get_mbind_nodemask(
+               &memkind_hbw_closest_numanode_g, nodemask, maxnode);
+}
+
+MEMKIND_EXPORT int memkind_hbw_all_get_mbind_nodemask(struct memkind *kind,
+                                                      unsigned long *nodemask,
+                                                      unsigned long maxnode)
+{
+    pthread_once(&memkind_hbw_closest_numanode_once_g,
+                 memkind_hbw_closest_numanode_init);
+    return memkind_closest_numanode_all_get_mbind_nodemask(
+               &memkind_hbw_closest_numanode_g, nodemask, maxnode);
+}
+
+// Sets bits of nodes of src in dst.
+static void closest_nodemask_copy(const struct memkind_closest_numanode_t *g,
+                                  const nodemask_t *src, struct bitmask *dst)
+{
+    struct bitmask src_bm = {NUMA_NUM_NODES, (unsigned long *)src->n};
+    int node;
+
+    for (node = 0; node < g->num_node; ++node) {
+        if (numa_bitmask_isbitset(&src_bm, node)) {
+            numa_bitmask_setbit(dst, node);
+        }
+    }
+}
+
+MEMKIND_EXPORT int memkind_closest_numanode_get_mbind_nodemask(
+    const struct memkind_closest_numanode_t *g, unsigned long *nodemask,
+    unsigned long maxnode)
+{
+    int cpu, node;
+    struct bitmask nodemask_bm = {maxnode, nodemask};
+
     if (MEMKIND_LIKELY(!g->init_err && nodemask)) {
         numa_bitmask_clearall(&nodemask_bm);
-        cpu = sched_getcpu();
-        if (MEMKIND_LIKELY(cpu < g->num_cpu)) {
-            numa_bitmask_setbit(&nodemask_bm, g->closest_numanode[cpu]);
+        // extents of node-affine arenas follow the node of the arena
+        node = memkind_arena_extent_node();
+        if (node < 0 || node >= g->num_node ||
+            g->closest_numanode_of_node[node] < 0) {
+            cpu = sched_getcpu();
+            if (MEMKIND_UNLIKELY(cpu >= g->num_cpu)) {
+                return MEMKIND_ERROR_RUNTIME;
+            }
+            node = g->closest_nodemask_of_node ? numa_node_of_cpu(cpu) : -1;
+            if (node < 0 || node >= g->num_node) {
+                numa_bitmask_setbit(&nodemask_bm, g->closest_numanode[cpu]);
+                return 0;
+            }
+        }
+        if (g->closest_nodemask_of_node) {
+            closest_nodemask_copy(g, &g->closest_nodemask_of_node[node],
+                                  &nodemask_bm);
         } else {
-            return MEMKIND_ERROR_RUNTIME;
+            numa_bitmask_setbit(&nodemask_bm, g->closest_numanode_of_node[node]);
         }
     }
     return g->init_err;
 }
 
-MEMKIND_EXPORT int memkind_hbw_all_get_mbind_nodemask(struct memkind *kind,
-                                                      unsigned long *nodemask,
-                                                      unsigned long maxnode)
+MEMKIND_EXPORT int memkind_closest_numanode_all_get_mbind_nodemask(
+    const struct memkind_closest_numanode_t *g, unsigned long *nodemask,
+    unsigned long maxnode)
 {
-    int cpu;
+    int cpu, node;
     struct bitmask nodemask_bm = {maxnode, nodemask};
-    struct memkind_hbw_closest_numanode_t *g =
-            &memkind_hbw_closest_numanode_g;
-    pthread_once(&memkind_hbw_closest_numanode_once_g,
-                 memkind_hbw_closest_numanode_init);
 
     if (MEMKIND_LIKELY(!g->init_err && nodemask)) {
         numa_bitmask_clearall(&nodemask_bm);
         for (cpu = 0; cpu < g->num_cpu; ++cpu) {
             numa_bitmask_setbit(&nodemask_bm, g->closest_numanode[cpu]);
         }
+        for (node = 0; g->closest_nodemask_of_node && node < g->num_node; ++node) {
+            closest_nodemask_copy(g, &g->closest_nodemask_of_node[node],
+                                  &nodemask_bm);
+        }
     }
     return g->init_err;
 }
@@ -295,21 +351,6 @@ static void assign_arbitrary_bandwidth_values(int* bandwidth, int bandwidth_len,
 
 }
 
-typedef struct registers_t {
-    uint32_t eax;
-    uint32_t ebx;
-    uint32_t ecx;
-    uint32_t edx;
-} registers_t;
-
-inline static void cpuid_asm(int leaf, int subleaf, registers_t* registers)
-{
-    asm volatile("cpuid":"=a"(registers->eax),
-                 "=b"(registers->ebx),
-                 "=c"(registers->ecx),
-                 "=d"(registers->edx):"0"(leaf), "2"(subleaf));
-}
-
 #define CPUID_MODEL_SHIFT       (4)
 #define CPUID_MODEL_MASK        (0xf)
 #define CPUID_EXT_MODEL_MASK    (0xf)
@@ -351,18 +392,22 @@ static int get_high_bandwidth_nodes(struct bitmask* hbw_node_mask)
     // Check if NUMA configuration is supported.
     if(nodes_num == 2 || nodes_num == 4 || nodes_num == 8) {
         struct bitmask* node_cpus = numa_allocate_cpumask();
+        struct bitmask* dax_kmem_nodes = numa_allocate_nodemask();
 
         assert(hbw_node_mask->size >= nodes_num);
         assert(node_cpus->size >= nodes_num);
+        memkind_dax_kmem_get_nodemask(dax_kmem_nodes);
         int i;
         for(i=0; i<nodes_num; i++) {
             numa_node_to_cpus(i, node_cpus);
-            if(numa_bitmask_weight(node_cpus) == 0) {
-                //NUMA nodes without CPU are HBW nodes.
+            //NUMA nodes without CPU are HBW nodes, unless onlined from DAX.
+            if(numa_bitmask_weight(node_cpus) == 0 &&
+               !numa_bitmask_isbitset(dax_kmem_nodes, i)) {
                 numa_bitmask_setbit(hbw_node_mask, i);
             }
         }
 
+        numa_bitmask_free(dax_kmem_nodes);
         numa_bitmask_free(node_cpus);
 
         if(2*numa_bitmask_weight(hbw_node_mask) == nodes_num) {
@@ -436,14 +481,32 @@ static int fill_nodes_bandwidth(int* bandwidth, int bandwidth_len)
                                                      hbw_nodes_env);
     }
 
+    // memory attributes reported by firmware take precedence over CPU model
+    if (memkind_hmat_fill_bandwidth(bandwidth, bandwidth_len) == 0) {
+        return 0;
+    }
+
     return fill_bandwidth_values_heuristically(bandwidth, bandwidth_len);
 }
 
 static void memkind_hbw_closest_numanode_init(void)
 {
-    struct memkind_hbw_closest_numanode_t *g =
-            &memkind_hbw_closest_numanode_g;
+    memkind_closest_numanode_init(&memkind_hbw_closest_numanode_g,
+                                  fill_nodes_bandwidth,
+                                  "high-bandwidth memory", false);
+}
+
+/*
+ * When allow_ties is set, a CPU as close to several nodes of the highest
+ * value as to any other is bound to all of them, otherwise such a CPU makes
+ * initialization fail.
+ */
+MEMKIND_EXPORT void memkind_closest_numanode_init(
+    struct memkind_closest_numanode_t *g, memkind_fill_values_t fill_values,
+    const char *memory_name, bool allow_ties)
+{
     int *bandwidth = NULL;
+    nodemask_t *closest_nodemask = NULL;
     int num_unique = 0;
     int high_bandwidth = 0;
     int i;
@@ -452,18 +515,30 @@ static void memkind_hbw_closest_numanode_init(void)
 
     g->num_cpu = numa_num_configured_cpus();
     g->closest_numanode = (int *)jemk_malloc(sizeof(int) * g->num_cpu);
+    g->closest_nodemask_of_node = NULL;
     bandwidth = (int *)jemk_malloc(sizeof(int) * NUMA_NUM_NODES);
+    if (allow_ties) {
+        closest_nodemask = (nodemask_t *)jemk_malloc(sizeof(nodemask_t) *
+                                                     g->num_cpu);
+    }
 
-    if (!(g->closest_numanode && bandwidth)) {
+    if (!(g->closest_numanode && bandwidth && (closest_nodemask || !allow_ties))) {
         g->init_err = MEMKIND_ERROR_MALLOC;
         log_err("jemk_malloc() failed.");
         goto exit;
     }
 
-    g->init_err = fill_nodes_bandwidth(bandwidth, NUMA_NUM_NODES);
+    g->init_err = fill_values(bandwidth, NUMA_NUM_NODES);
     if (g->init_err)
         goto exit;
 
+    // values may come from sysfs of another machine, see MEMKIND_SYSFS_ROOT
+    for (i = 0; i < NUMA_NUM_NODES; i++) {
+        if (!numa_bitmask_isbitset(numa_nodes_ptr, i)) {
+            bandwidth[i] = 0;
+        }
+    }
+
     g->init_err = create_bandwidth_nodes(NUMA_NUM_NODES, bandwidth,
                                          &num_unique, &bandwidth_nodes);
     if (g->init_err)
@@ -472,21 +547,53 @@ static void memkind_hbw_closest_numanode_init(void)
     high_bandwidth = bandwidth_nodes[num_unique-1].bandwidth;
     g->init_err = set_closest_numanode(num_unique, bandwidth_nodes,
                                        high_bandwidth, g->num_cpu,
-                                       g->closest_numanode);
+                                       g->closest_numanode, closest_nodemask);
+    if (g->init_err)
+        goto exit;
+
+    g->num_node = numa_max_node() + 1;
+    g->closest_numanode_of_node = (int *)jemk_malloc(sizeof(int) * g->num_node);
+    if (allow_ties) {
+        g->closest_nodemask_of_node = (nodemask_t *)jemk_calloc(g->num_node,
+                                                                sizeof(nodemask_t));
+    }
+    if (!g->closest_numanode_of_node ||
+        (allow_ties && !g->closest_nodemask_of_node)) {
+        g->init_err = MEMKIND_ERROR_MALLOC;
+        log_err("jemk_malloc() failed.");
+        goto exit;
+    }
+    for (i = 0; i < g->num_node; i++) {
+        g->closest_numanode_of_node[i] = -1;
+    }
+    for (i = 0; i < g->num_cpu; i++) {
+        int node = numa_node_of_cpu(i);
+        if (node >= 0 && node < g->num_node) {
+            g->closest_numanode_of_node[node] = g->closest_numanode[i];
+            // distances are the same for all CPUs of a node
+            if (allow_ties) {
+                g->closest_nodemask_of_node[node] = closest_nodemask[i];
+            }
+        }
+    }
 
     for(i=0; i<bandwidth_nodes[num_unique-1].num_numanodes; i++) {
-        log_info("NUMA node %d is high-bandwidth memory.",
-                 bandwidth_nodes[num_unique-1].numanodes[i]);
+        log_info("NUMA node %d is %s.",
+                 bandwidth_nodes[num_unique-1].numanodes[i], memory_name);
     }
 
 exit:
 
     jemk_free(bandwidth_nodes);
     jemk_free(bandwidth);
+    jemk_free(closest_nodemask);
 
     if (g->init_err) {
         jemk_free(g->closest_numanode);
         g->closest_numanode = NULL;
+        jemk_free(g->closest_nodemask_of_node);
+        g->closest_nodemask_of_node = NULL;
+        g->num_node = 0;
     }
 }
 
@@ -590,7 +697,8 @@ static int create_bandwidth_nodes(int num_bandwidth, const int *bandwidth,
 
 static int set_closest_numanode(int num_unique,
                                 const struct bandwidth_nodes_t *bandwidth_nodes,
-                                int target_bandwidth, int num_cpunode, int *closest_numanode)
+                                int target_bandwidth, int num_cpunode, int *closest_numanode,
+                                nodemask_t *closest_nodemask)
 {
     /***************************************************************************
     *   num_unique (IN):                                                       *
@@ -604,6 +712,9 @@ static int set_closest_numanode(int num_unique,
     *   closest_numanode (OUT):                                                *
     *       Vector that maps cpu index to closest numa node of the specified   *
     *       bandwidth.                                                         *
+    *   closest_nodemask (OUT):                                                *
+    *       Vector that maps cpu index to all equally close numa nodes of the  *
+    *       specified bandwidth, NULL makes such a tie an error.               *
     *   RETURNS zero on success, error code on failure                         *
     ***************************************************************************/
     int err = 0;
@@ -623,8 +734,14 @@ static int set_closest_numanode(int num_unique,
         err = MEMKIND_ERROR_UNAVAILABLE;
     } else {
         for (i = 0; i < num_cpunode; ++i) {
+            struct bitmask closest_bm;
             min_distance = INT_MAX;
             min_unique = 1;
+            if (closest_nodemask) {
+                closest_bm.size = NUMA_NUM_NODES;
+                closest_bm.maskp = closest_nodemask[i].n;
+                numa_bitmask_clearall(&closest_bm);
+            }
             for (j = 0; j < match.num_numanodes; ++j) {
                 old_errno = errno;
                 distance = numa_distance(numa_node_of_cpu(i),
@@ -634,11 +751,17 @@ static int set_closest_numanode(int num_unique,
                     min_distance = distance;
                     closest_numanode[i] = match.numanodes[j];
                     min_unique = 1;
+                    if (closest_nodemask) {
+                        numa_bitmask_clearall(&closest_bm);
+                    }
                 } else if (distance == min_distance) {
                     min_unique = 0;
                 }
+                if (closest_nodemask && distance == min_distance) {
+                    numa_bitmask_setbit(&closest_bm, match.numanodes[j]);
+                }
             }
-            if (!min_unique) {
+            if (!min_unique && !closest_nodemask) {
                 err = MEMKIND_ERROR_RUNTIME;
             }
         }
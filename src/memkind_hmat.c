@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_default.h>
+#include <memkind/internal/memkind_arena.h>
+#include <memkind/internal/memkind_private.h>
+#include <memkind/internal/memkind_log.h>
+#include <memkind/internal/heap_manager.h>
+
+#include <numa.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+
+/*
+ * Since Linux 5.2 the kernel exports performance of memory of each NUMA
+ * node, as seen from the initiators (CPUs) closest to it, to
+ * /sys/devices/system/node/nodeN/access0/initiators/. The root of sysfs can
+ * be moved with MEMKIND_SYSFS_ROOT, so that trees of other machines can be
+ * used for testing.
+ */
+
+// Values within 1/HMAT_TIER_TOLERANCE of each other belong to one tier
+#define HMAT_TIER_TOLERANCE 10
+// High bandwidth memory must be faster than memory of nodes with CPUs by
+// at least 1/HMAT_HBW_MARGIN
+#define HMAT_HBW_MARGIN 4
+
+static const char *const hmat_attr_name[MEMKIND_HMAT_ATTR_MAX] = {
+    [MEMKIND_HMAT_READ_BANDWIDTH] = "read_bandwidth",
+    [MEMKIND_HMAT_WRITE_BANDWIDTH] = "write_bandwidth",
+    [MEMKIND_HMAT_READ_LATENCY] = "read_latency",
+    [MEMKIND_HMAT_WRITE_LATENCY] = "write_latency",
+};
+
+MEMKIND_EXPORT const char *memkind_sysfs_root(void)
+{
+    const char *root = getenv("MEMKIND_SYSFS_ROOT");
+    return root ? root : "/sys";
+}
+
+// Reads first line of file of node into buf, returns 0 on success.
+static int sysfs_node_read(int node, const char *file, char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/devices/system/node/node%d/%s",
+             memkind_sysfs_root(), node, file);
+    fp = fopen(path, "r");
+    if (!fp) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    if (!fgets(buf, size, fp)) {
+        buf[0] = '\0';
+    }
+    fclose(fp);
+    return 0;
+}
+
+MEMKIND_EXPORT bool memkind_sysfs_node_exists(int node)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/devices/system/node/node%d",
+             memkind_sysfs_root(), node);
+    return access(path, F_OK) == 0;
+}
+
+MEMKIND_EXPORT bool memkind_sysfs_node_has_cpus(int node)
+{
+    char buf[64];
+    char *c;
+
+    if (sysfs_node_read(node, "cpulist", buf, sizeof(buf))) {
+        return false;
+    }
+    for (c = buf; *c; ++c) {
+        if (isdigit((unsigned char)*c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MEMKIND_EXPORT int memkind_hmat_get_attr(int node, memkind_hmat_attr_t attr,
+                                         unsigned long *value)
+{
+    char file[64];
+    char buf[64];
+    char *end;
+
+    if (attr >= MEMKIND_HMAT_ATTR_MAX) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    snprintf(file, sizeof(file), "access0/initiators/%s", hmat_attr_name[attr]);
+    if (sysfs_node_read(node, file, buf, sizeof(buf))) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    *value = strtoul(buf, &end, 10);
+    // the kernel reports 0 when the attribute is not provided by firmware
+    if (end == buf || *value == 0) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    return 0;
+}
+
+// Bandwidth of node is the lower of read and write bandwidths it reports.
+static unsigned long hmat_node_bandwidth(int node)
+{
+    unsigned long read_bw = 0, write_bw = 0;
+
+    memkind_hmat_get_attr(node, MEMKIND_HMAT_READ_BANDWIDTH, &read_bw);
+    memkind_hmat_get_attr(node, MEMKIND_HMAT_WRITE_BANDWIDTH, &write_bw);
+    if (read_bw && write_bw) {
+        return read_bw < write_bw ? read_bw : write_bw;
+    }
+    return read_bw ? read_bw : write_bw;
+}
+
+/*
+ * Fills bandwidth of nodes in MB/s, 0 for nodes without attributes. Nodes in
+ * the top tier get the same value, so they are all treated as high bandwidth
+ * memory. Fails unless the top tier is clearly faster than memory of every
+ * node with CPUs, i.e. there is no memory which should be called high
+ * bandwidth on the machine.
+ */
+MEMKIND_EXPORT int memkind_hmat_fill_bandwidth(int *bandwidth,
+                                               int bandwidth_len)
+{
+    unsigned long node_bw, max_bw = 0, cpu_bw = 0;
+    int node, top_tier = 0;
+
+    for (node = 0; node < bandwidth_len; ++node) {
+        node_bw = memkind_sysfs_node_exists(node) ? hmat_node_bandwidth(node) : 0;
+        if (node_bw > INT_MAX) {
+            node_bw = INT_MAX;
+        }
+        bandwidth[node] = node_bw;
+        if (node_bw > max_bw) {
+            max_bw = node_bw;
+        }
+        if (node_bw > cpu_bw && memkind_sysfs_node_has_cpus(node)) {
+            cpu_bw = node_bw;
+        }
+    }
+    if (max_bw == 0) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    if (max_bw <= cpu_bw + cpu_bw / HMAT_HBW_MARGIN) {
+        log_info("No memory faster than memory of nodes with CPUs in HMAT.");
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    for (node = 0; node < bandwidth_len; ++node) {
+        if (bandwidth[node] &&
+            (unsigned long)bandwidth[node] >= max_bw - max_bw / HMAT_TIER_TOLERANCE) {
+            bandwidth[node] = max_bw;
+            ++top_tier;
+        }
+    }
+    log_info("Detected %d high-bandwidth memory node(s) in HMAT.", top_tier);
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_sysfs_node_capacity(int node,
+                                               unsigned long long *capacity)
+{
+    char buf[128];
+    int buf_node;
+
+    // first line of meminfo is "Node N MemTotal: X kB"
+    if (sysfs_node_read(node, "meminfo", buf, sizeof(buf)) ||
+        sscanf(buf, "Node %d MemTotal: %llu kB", &buf_node, capacity) != 2) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    *capacity <<= 10;
+    return 0;
+}
+
+// Latency of node is the higher of read and write latencies it reports.
+static unsigned long hmat_node_latency(int node)
+{
+    unsigned long read_lat = 0, write_lat = 0;
+
+    memkind_hmat_get_attr(node, MEMKIND_HMAT_READ_LATENCY, &read_lat);
+    memkind_hmat_get_attr(node, MEMKIND_HMAT_WRITE_LATENCY, &write_lat);
+    return read_lat > write_lat ? read_lat : write_lat;
+}
+
+/*
+ * Both fill functions below rank nodes the way memkind_closest_numanode_init()
+ * expects: 2 for nodes of the selected tier, 1 for other nodes with memory
+ * and 0 for nodes which do not exist.
+ */
+MEMKIND_EXPORT int memkind_hmat_fill_lowest_latency(int *values,
+                                                    int values_len)
+{
+    unsigned long node_lat, min_lat = ULONG_MAX;
+    int node, cpu_nodes = 0;
+
+    for (node = 0; node < values_len; ++node) {
+        values[node] = 0;
+        if (!memkind_sysfs_node_exists(node)) {
+            continue;
+        }
+        node_lat = hmat_node_latency(node);
+        if (node_lat && node_lat < min_lat) {
+            min_lat = node_lat;
+        }
+        values[node] = 1;
+    }
+    if (min_lat == ULONG_MAX) {
+        // without attributes memory local to CPUs is assumed to be the fastest
+        for (node = 0; node < values_len; ++node) {
+            if (values[node] && memkind_sysfs_node_has_cpus(node)) {
+                values[node] = 2;
+                ++cpu_nodes;
+            }
+        }
+        log_info("No latency in HMAT, using memory of nodes with CPUs.");
+        return cpu_nodes ? 0 : MEMKIND_ERROR_UNAVAILABLE;
+    }
+    for (node = 0; node < values_len; ++node) {
+        node_lat = values[node] ? hmat_node_latency(node) : 0;
+        if (node_lat && node_lat <= min_lat + min_lat / HMAT_TIER_TOLERANCE) {
+            values[node] = 2;
+        }
+    }
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_sysfs_fill_highest_capacity(int *values,
+                                                       int values_len)
+{
+    unsigned long long node_cap, max_cap = 0;
+    int node;
+
+    for (node = 0; node < values_len; ++node) {
+        values[node] = 0;
+        if (memkind_sysfs_node_capacity(node, &node_cap) == 0 && node_cap) {
+            values[node] = 1;
+            if (node_cap > max_cap) {
+                max_cap = node_cap;
+            }
+        }
+    }
+    if (max_cap == 0) {
+        return MEMKIND_ERROR_UNAVAILABLE;
+    }
+    for (node = 0; node < values_len; ++node) {
+        if (values[node] && memkind_sysfs_node_capacity(node, &node_cap) == 0 &&
+            node_cap >= max_cap - max_cap / HMAT_TIER_TOLERANCE) {
+            values[node] = 2;
+        }
+    }
+    return 0;
+}
+
+static struct memkind_closest_numanode_t lowest_latency_closest_numanode_g;
+static pthread_once_t lowest_latency_closest_numanode_once_g =
+    PTHREAD_ONCE_INIT;
+
+static struct memkind_closest_numanode_t highest_capacity_closest_numanode_g;
+static pthread_once_t highest_capacity_closest_numanode_once_g =
+    PTHREAD_ONCE_INIT;
+
+static void lowest_latency_closest_numanode_init(void)
+{
+    memkind_closest_numanode_init(&lowest_latency_closest_numanode_g,
+                                  memkind_hmat_fill_lowest_latency,
+                                  "lowest latency memory", true);
+}
+
+static void highest_capacity_closest_numanode_init(void)
+{
+    memkind_closest_numanode_init(&highest_capacity_closest_numanode_g,
+                                  memkind_sysfs_fill_highest_capacity,
+                                  "highest capacity memory", true);
+}
+
+MEMKIND_EXPORT int memkind_lowest_latency_get_mbind_nodemask(struct memkind *kind,
+                                                             unsigned long *nodemask,
+                                                             unsigned long maxnode)
+{
+    pthread_once(&lowest_latency_closest_numanode_once_g,
+                 lowest_latency_closest_numanode_init);
+    return memkind_closest_numanode_get_mbind_nodemask(
+               &lowest_latency_closest_numanode_g, nodemask, maxnode);
+}
+
+MEMKIND_EXPORT int memkind_lowest_latency_all_get_mbind_nodemask(struct memkind *kind,
+                                                                 unsigned long *nodemask,
+                                                                 unsigned long maxnode)
+{
+    pthread_once(&lowest_latency_closest_numanode_once_g,
+                 lowest_latency_closest_numanode_init);
+    return memkind_closest_numanode_all_get_mbind_nodemask(
+               &lowest_latency_closest_numanode_g, nodemask, maxnode);
+}
+
+MEMKIND_EXPORT int memkind_highest_capacity_get_mbind_nodemask(struct memkind *kind,
+                                                               unsigned long *nodemask,
+                                                               unsigned long maxnode)
+{
+    pthread_once(&highest_capacity_closest_numanode_once_g,
+                 highest_capacity_closest_numanode_init);
+    return memkind_closest_numanode_get_mbind_nodemask(
+               &highest_capacity_closest_numanode_g, nodemask, maxnode);
+}
+
+MEMKIND_EXPORT int memkind_highest_capacity_all_get_mbind_nodemask(struct memkind *kind,
+                                                                   unsigned long *nodemask,
+                                                                   unsigned long maxnode)
+{
+    pthread_once(&highest_capacity_closest_numanode_once_g,
+                 highest_capacity_closest_numanode_init);
+    return memkind_closest_numanode_all_get_mbind_nodemask(
+               &highest_capacity_closest_numanode_g, nodemask, maxnode);
+}
+
+static int memkind_hmat_check_available(struct memkind *kind)
+{
+    return kind->ops->get_mbind_nodemask(kind, NULL, 0);
+}
+
+static void lowest_latency_init_once(void)
+{
+    memkind_init(MEMKIND_LOWEST_LATENCY, true);
+}
+
+static void highest_capacity_init_once(void)
+{
+    memkind_init(MEMKIND_HIGHEST_CAPACITY, true);
+}
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_LOWEST_LATENCY_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_default_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = heap_manager_free,
+    .check_available = memkind_hmat_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_default_get_mbind_mode,
+    .get_mbind_nodemask = memkind_lowest_latency_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .init_once = lowest_latency_init_once,
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_HIGHEST_CAPACITY_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_default_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = heap_manager_free,
+    .check_available = memkind_hmat_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_default_get_mbind_mode,
+    .get_mbind_nodemask = memkind_highest_capacity_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .init_once = highest_capacity_init_once,
+    .finalize = memkind_arena_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind/internal/memkind_memtype.h>
+#include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_hugetlb.h>
+#include <memkind/internal/memkind_default.h>
+#include <memkind/internal/memkind_arena.h>
+#include <memkind/internal/memkind_private.h>
+#include <memkind/internal/memkind_log.h>
+#include <memkind/internal/heap_manager.h>
+
+#include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+
+/*
+ * Every memory type provides the nodes closest to the calling CPU (local
+ * policies) and all of its nodes (other policies). Nodes of the selected
+ * memory types are merged into one nodemask, which is bound with the mode
+ * of the policy.
+ */
+
+struct memkind_memtype {
+    memkind_memtype_t memtype_flags;
+    memkind_policy_t policy;
+};
+
+typedef int (*get_mbind_nodemask_t)(struct memkind *kind,
+                                    unsigned long *nodemask,
+                                    unsigned long maxnode);
+
+struct memtype_nodes {
+    memkind_memtype_t memtype;
+    get_mbind_nodemask_t local_nodemask;
+    get_mbind_nodemask_t all_nodemask;
+};
+
+// Standard memory local to the CPU, or to the node of a node-affine arena.
+static int default_get_mbind_nodemask(struct memkind *kind,
+                                      unsigned long *nodemask,
+                                      unsigned long maxnode)
+{
+    struct bitmask nodemask_bm = {maxnode, nodemask};
+    int node;
+
+    if (nodemask) {
+        node = memkind_arena_extent_node();
+        if (node < 0) {
+            node = numa_node_of_cpu(sched_getcpu());
+        }
+        if (node < 0) {
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        numa_bitmask_clearall(&nodemask_bm);
+        numa_bitmask_setbit(&nodemask_bm, node);
+    }
+    return 0;
+}
+
+// Standard memory of all nodes the process may use.
+static int default_all_get_mbind_nodemask(struct memkind *kind,
+                                          unsigned long *nodemask,
+                                          unsigned long maxnode)
+{
+    struct bitmask nodemask_bm = {maxnode, nodemask};
+
+    if (nodemask) {
+        copy_bitmask_to_bitmask(numa_all_nodes_ptr, &nodemask_bm);
+    }
+    return 0;
+}
+
+static const struct memtype_nodes memtype_nodes_g[] = {
+    {
+        MEMKIND_MEMTYPE_DEFAULT,
+        default_get_mbind_nodemask,
+        default_all_get_mbind_nodemask
+    },
+    {
+        MEMKIND_MEMTYPE_HIGH_BANDWIDTH,
+        memkind_hbw_get_mbind_nodemask,
+        memkind_hbw_all_get_mbind_nodemask
+    },
+    {
+        MEMKIND_MEMTYPE_LOWEST_LATENCY,
+        memkind_lowest_latency_get_mbind_nodemask,
+        memkind_lowest_latency_all_get_mbind_nodemask
+    },
+    {
+        MEMKIND_MEMTYPE_HIGHEST_CAPACITY,
+        memkind_highest_capacity_get_mbind_nodemask,
+        memkind_highest_capacity_all_get_mbind_nodemask
+    },
+};
+
+#define MEMTYPE_NODES_NUM (sizeof(memtype_nodes_g) / sizeof(memtype_nodes_g[0]))
+
+static bool policy_is_local(memkind_policy_t policy)
+{
+    return policy == MEMKIND_POLICY_BIND_LOCAL ||
+           policy == MEMKIND_POLICY_PREFERRED_LOCAL ||
+           policy == MEMKIND_POLICY_INTERLEAVE_LOCAL;
+}
+
+MEMKIND_EXPORT int memkind_memtype_init(struct memkind *kind,
+                                        memkind_memtype_t memtype_flags,
+                                        memkind_policy_t policy)
+{
+    struct memkind_memtype *priv;
+
+    priv = (struct memkind_memtype *)jemk_malloc(sizeof(struct memkind_memtype));
+    if (!priv) {
+        log_err("jemk_malloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+    priv->memtype_flags = memtype_flags;
+    priv->policy = policy;
+    kind->priv = priv;
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_memtype_destroy(struct memkind *kind)
+{
+    memkind_arena_destroy(kind);
+    jemk_free(kind->priv);
+    kind->priv = NULL;
+    return 0;
+}
+
+static int memkind_memtype_get_mbind_nodemask(struct memkind *kind,
+                                              unsigned long *nodemask,
+                                              unsigned long maxnode)
+{
+    const struct memkind_memtype *priv = kind->priv;
+    bool local = policy_is_local(priv->policy);
+    struct bitmask nodemask_bm = {maxnode, nodemask};
+    nodemask_t memtype_nodemask;
+    unsigned long i, j, words;
+    int err;
+
+    if (nodemask) {
+        numa_bitmask_clearall(&nodemask_bm);
+    }
+    if (maxnode > NUMA_NUM_NODES) {
+        maxnode = NUMA_NUM_NODES;
+    }
+    words = (maxnode + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long));
+    for (i = 0; i < MEMTYPE_NODES_NUM; ++i) {
+        const struct memtype_nodes *m = &memtype_nodes_g[i];
+        if (!(priv->memtype_flags & m->memtype)) {
+            continue;
+        }
+        get_mbind_nodemask_t get_nodemask = local ? m->local_nodemask :
+                                            m->all_nodemask;
+        err = get_nodemask(kind, nodemask ? memtype_nodemask.n : NULL, maxnode);
+        if (err) {
+            return err;
+        }
+        for (j = 0; nodemask && j < words; ++j) {
+            nodemask[j] |= memtype_nodemask.n[j];
+        }
+    }
+    return 0;
+}
+
+static int memkind_memtype_get_mbind_mode(struct memkind *kind, int *mode)
+{
+    const struct memkind_memtype *priv = kind->priv;
+
+    switch (priv->policy) {
+        case MEMKIND_POLICY_PREFERRED_LOCAL:
+            *mode = MPOL_PREFERRED;
+            break;
+        case MEMKIND_POLICY_INTERLEAVE_LOCAL:
+        case MEMKIND_POLICY_INTERLEAVE_ALL:
+            *mode = MPOL_INTERLEAVE;
+            break;
+        default:
+            *mode = MPOL_BIND;
+            break;
+    }
+    return 0;
+}
+
+// Interleaved pages are not merged into transparent huge pages.
+static int memkind_memtype_madvise(struct memkind *kind, void *addr,
+                                   size_t size)
+{
+    const struct memkind_memtype *priv = kind->priv;
+
+    if (priv->policy == MEMKIND_POLICY_INTERLEAVE_LOCAL ||
+        priv->policy == MEMKIND_POLICY_INTERLEAVE_ALL) {
+        return memkind_nohugepage_madvise(kind, addr, size);
+    }
+    return 0;
+}
+
+static int memkind_memtype_check_available(struct memkind *kind)
+{
+    return memkind_memtype_get_mbind_nodemask(kind, NULL, 0);
+}
+
+static int memkind_memtype_hugetlb_check_available(struct memkind *kind)
+{
+    int err = memkind_memtype_check_available(kind);
+
+    if (!err) {
+        err = memkind_hugetlb_check_available_2mb(kind);
+    }
+    return err;
+}
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_MEMTYPE_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_memtype_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = memkind_arena_free,
+    .check_available = memkind_memtype_check_available,
+    .mbind = memkind_default_mbind,
+    .madvise = memkind_memtype_madvise,
+    .get_mmap_flags = memkind_default_get_mmap_flags,
+    .get_mbind_mode = memkind_memtype_get_mbind_mode,
+    .get_mbind_nodemask = memkind_memtype_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .finalize = memkind_memtype_destroy,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
+
+MEMKIND_EXPORT struct memkind_ops MEMKIND_MEMTYPE_HUGETLB_OPS = {
+    .create = memkind_arena_create,
+    .destroy = memkind_memtype_destroy,
+    .malloc = memkind_arena_malloc,
+    .calloc = memkind_arena_calloc,
+    .posix_memalign = memkind_arena_posix_memalign,
+    .realloc = memkind_arena_realloc,
+    .free = memkind_arena_free,
+    .check_available = memkind_memtype_hugetlb_check_available,
+    .mbind = memkind_default_mbind,
+    .get_mmap_flags = memkind_hugetlb_get_mmap_flags,
+    .get_mbind_mode = memkind_memtype_get_mbind_mode,
+    .get_mbind_nodemask = memkind_memtype_get_mbind_nodemask,
+    .get_arena = memkind_thread_get_arena,
+    .finalize = memkind_memtype_destroy,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
+};
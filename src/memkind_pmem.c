@@ -28,11 +28,16 @@
 #include <memkind/internal/memkind_log.h>
 
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <jemalloc/jemalloc.h>
 #include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/param.h>
+#include <sched.h>
 
 MEMKIND_EXPORT struct memkind_ops MEMKIND_PMEM_OPS = {
     .create = memkind_pmem_create,
@@ -40,15 +45,29 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_PMEM_OPS = {
     .malloc = memkind_arena_malloc,
     .calloc = memkind_arena_calloc,
     .posix_memalign = memkind_arena_posix_memalign,
-    .realloc = memkind_arena_realloc,
-    .free = memkind_arena_free,
+    .realloc = memkind_pmem_realloc,
+    .free = memkind_pmem_free,
     .mmap = memkind_pmem_mmap,
     .get_mmap_flags = memkind_pmem_get_mmap_flags,
     .get_arena = memkind_thread_get_arena,
     .finalize = memkind_pmem_destroy,
-    .malloc_usable_size = memkind_default_malloc_usable_size
+    .malloc_usable_size = memkind_pmem_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
+static void *pmem_mmap(struct memkind *kind, size_t size, size_t alignment,
+                       bool *zeroed);
+static void *pmem_prefault_take(struct memkind_pmem_prefault *prefault,
+                                size_t size, size_t alignment, bool *zeroed);
+static bool pmem_prefault_release(struct memkind *kind);
+static void pmem_prefault_wake(struct memkind_pmem_prefault *prefault);
+static void pmem_prefault_stop(struct memkind *kind);
+static int pmem_persist(struct memkind_pmem *priv, const void *ptr, size_t len);
+static int pmem_commit(struct memkind_pmem *priv, void *addr, size_t len);
+
+// open persistent kinds, their objects can be freed without the kind
+static unsigned pmem_recovered_kinds = 0;
+
 void *pmem_extent_alloc(extent_hooks_t *extent_hooks,
                         void *new_addr,
                         size_t size,
@@ -59,6 +78,7 @@ void *pmem_extent_alloc(extent_hooks_t *extent_hooks,
 {
     int err;
     void *addr = NULL;
+    bool zeroed = false;
 
     if (new_addr != NULL) {
         /* not supported */
@@ -76,13 +96,23 @@ void *pmem_extent_alloc(extent_hooks_t *extent_hooks,
         goto exit;
     }
 
-    addr = memkind_pmem_mmap(kind, new_addr, size);
+    struct memkind_pmem *priv = kind->priv;
+    addr = MAP_FAILED;
+    if (priv->prefault) {
+        addr = pmem_prefault_take(priv->prefault, size, alignment, &zeroed);
+    }
+    if (addr == MAP_FAILED) {
+        addr = pmem_mmap(kind, size, alignment, &zeroed);
+    }
+    /* memory prepared in advance counts against max_size of the kind */
+    if (addr == MAP_FAILED && priv->prefault && pmem_prefault_release(kind)) {
+        addr = pmem_mmap(kind, size, alignment, &zeroed);
+    }
 
     if (addr != MAP_FAILED) {
-        *zero = true;
+        /* recycled file space keeps its previous content */
+        *zero = zeroed;
         *commit = true;
-
-        /* XXX - check alignment */
     } else {
         addr = NULL;
     }
@@ -96,13 +126,37 @@ bool pmem_extent_dalloc(extent_hooks_t *extent_hooks,
                         bool committed,
                         unsigned arena_ind)
 {
-    if (munmap(addr, size) == -1) {
-        log_err("munmap failed!");
+    struct memkind *kind = get_kind_by_arena(arena_ind);
+    struct memkind_pmem *priv = kind->priv;
+
+    /*
+     * Extents carved out of the reserved mapping stay mapped, their file
+     * blocks are released and the range is reused by the next extent which
+     * does not fit in the unused end of the file. Objects of persistent kind
+     * being destroyed must stay in the file, these extents are retained.
+     */
+    if (priv->addr) {
+        if (priv->closing) {
+            return true;
+        }
+        (void) madvise(addr, size, MADV_REMOVE);
+    }
+
+    /* on failure extent is kept mapped and is retained by jemalloc */
+    if (memkind_pmem_munmap(kind, addr, size) != 0) {
+        return true;
+    }
+    if (priv->prefault) {
+        pmem_prefault_wake(priv->prefault);
     }
-    /* do nothing - report failure (opt-out) */
-    return true;
+    return false;
 }
 
+/*
+ * Decommit punched a hole in the file, so file system blocks are allocated
+ * again. Failure is reported to jemalloc instead of raising SIGBUS when
+ * the memory is written later.
+ */
 bool pmem_extent_commit(extent_hooks_t *extent_hooks,
                         void *addr,
                         size_t size,
@@ -110,19 +164,9 @@ bool pmem_extent_commit(extent_hooks_t *extent_hooks,
                         size_t length,
                         unsigned arena_ind)
 {
-    /* do nothing - report success */
-    return false;
-}
+    struct memkind_pmem *priv = get_kind_by_arena(arena_ind)->priv;
 
-bool pmem_extent_decommit(extent_hooks_t *extent_hooks,
-                          void *addr,
-                          size_t size,
-                          size_t offset,
-                          size_t length,
-                          unsigned arena_ind)
-{
-    /* do nothing - report failure (opt-out) */
-    return true;
+    return pmem_commit(priv, (char *)addr + offset, length) != 0;
 }
 
 bool pmem_extent_purge(extent_hooks_t *extent_hooks,
@@ -132,8 +176,35 @@ bool pmem_extent_purge(extent_hooks_t *extent_hooks,
                        size_t length,
                        unsigned arena_ind)
 {
-    /* do nothing - report failure (opt-out) */
-    return true;
+    struct memkind_pmem *priv = get_kind_by_arena(arena_ind)->priv;
+
+    /* destroying the arena releases all objects, which must stay in the file */
+    if (priv->closing) {
+        return true;
+    }
+
+    /*
+     * Punch a hole in the file backing the range, so file system blocks are
+     * released. Range reads as zeros afterwards.
+     */
+    return madvise((char *)addr + offset, length, MADV_REMOVE) != 0;
+}
+
+/*
+ * jemalloc reuses purged memory without calling commit, and writing to a
+ * hole needs a free file system block, so holes are punched mostly on
+ * decommit, which is followed by commit before the memory is reused. Lazy
+ * purge is not provided, so decay decommits dirty extents instead. Forced
+ * purge is used only when decommit fails or an extent is leaked.
+ */
+bool pmem_extent_decommit(extent_hooks_t *extent_hooks,
+                          void *addr,
+                          size_t size,
+                          size_t offset,
+                          size_t length,
+                          unsigned arena_ind)
+{
+    return pmem_extent_purge(extent_hooks, addr, size, offset, length, arena_ind);
 }
 
 bool pmem_extent_split(extent_hooks_t *extent_hooks,
@@ -148,6 +219,8 @@ bool pmem_extent_split(extent_hooks_t *extent_hooks,
     return false;
 }
 
+static size_t pmem_stripe_find(struct memkind_pmem *priv, void *addr);
+
 bool pmem_extent_merge(extent_hooks_t *extent_hooks,
                        void *addr_a,
                        size_t size_a,
@@ -156,6 +229,13 @@ bool pmem_extent_merge(extent_hooks_t *extent_hooks,
                        bool committed,
                        unsigned arena_ind)
 {
+    struct memkind_pmem *priv = get_kind_by_arena(arena_ind)->priv;
+
+    /* extent is unmapped as a whole later, so it must not span two files */
+    if (priv->stripes) {
+        return pmem_stripe_find(priv, addr_a) != pmem_stripe_find(priv, addr_b);
+    }
+
     /* do nothing - report success */
     return false;
 }
@@ -166,8 +246,19 @@ void pmem_extent_destroy(extent_hooks_t *extent_hooks,
                          bool committed,
                          unsigned arena_ind)
 {
-    if (munmap(addr, size) == -1) {
-        log_err("munmap failed!");
+    struct memkind *kind = get_kind_by_arena(arena_ind);
+    struct memkind_pmem *priv = kind->priv;
+
+    /* reserved mapping is unmapped as a whole when kind is destroyed */
+    if (priv->addr) {
+        return;
+    }
+
+    if (memkind_pmem_munmap(kind, addr, size) != 0) {
+        /* file space is lost until kind is destroyed, but mapping is not */
+        if (munmap(addr, size) == -1) {
+            log_err("munmap failed!");
+        }
     }
 }
 
@@ -176,12 +267,51 @@ static extent_hooks_t pmem_extent_hooks = {
     .dalloc = pmem_extent_dalloc,
     .commit = pmem_extent_commit,
     .decommit = pmem_extent_decommit,
-    .purge_lazy = pmem_extent_purge,
+    .purge_forced = pmem_extent_purge,
     .split = pmem_extent_split,
     .merge = pmem_extent_merge,
     .destroy = pmem_extent_destroy
 };
 
+static int pmem_init(struct memkind_pmem *priv)
+{
+    priv->fd = -1;
+    priv->offset = 0;
+    priv->max_size = 0;
+    priv->alignment = MEMKIND_PMEM_CHUNK_SIZE;
+    priv->addr = NULL;
+    priv->header = NULL;
+    priv->recovered = 0;
+    priv->recovered_map = NULL;
+    priv->closing = false;
+    priv->mmap_flags = 0;
+    priv->flush_type = MEMKIND_PMEM_FLUSH_AUTO;
+    priv->free_ranges = NULL;
+    priv->free_ranges_num = 0;
+    priv->free_ranges_cap = 0;
+    priv->extents = NULL;
+    priv->extents_num = 0;
+    priv->extents_cap = 0;
+    priv->stripes = NULL;
+    priv->stripes_num = 0;
+    priv->next_stripe = 0;
+    priv->prefault = NULL;
+
+    return pthread_mutex_init(&priv->pmem_lock, NULL);
+}
+
+static void pmem_fini(struct memkind_pmem *priv)
+{
+    pthread_mutex_destroy(&priv->pmem_lock);
+
+    if (priv->fd != -1) {
+        (void) close(priv->fd);
+    }
+    jemk_free(priv->free_ranges);
+    jemk_free(priv->extents);
+    jemk_free(priv->recovered_map);
+}
+
 MEMKIND_EXPORT int memkind_pmem_create(struct memkind *kind,
                                        struct memkind_ops *ops, const char *name)
 {
@@ -194,9 +324,9 @@ MEMKIND_EXPORT int memkind_pmem_create(struct memkind *kind,
         return MEMKIND_ERROR_MALLOC;
     }
 
-    if (pthread_mutex_init(&priv->pmem_lock, NULL) != 0) {
-        err = MEMKIND_ERROR_RUNTIME;
-        goto exit;
+    if (pmem_init(priv) != 0) {
+        jemk_free(priv);
+        return MEMKIND_ERROR_RUNTIME;
     }
 
     err = memkind_default_create(kind, ops, name);
@@ -223,38 +353,664 @@ MEMKIND_EXPORT int memkind_pmem_destroy(struct memkind *kind)
 {
     struct memkind_pmem *priv = kind->priv;
 
+    if (priv->prefault) {
+        pmem_prefault_stop(kind);
+    }
+
+    priv->closing = (priv->header != NULL);
     memkind_arena_destroy(kind);
 
-    pthread_mutex_destroy(&priv->pmem_lock);
+    if (priv->header && fsync(priv->fd) != 0) {
+        log_err("fsync() failed.");
+    }
+
+    if (priv->addr && munmap(priv->addr, priv->max_size) == -1) {
+        log_err("munmap failed!");
+    }
+
+    if (priv->stripes) {
+        size_t i;
+        for (i = 0; i < priv->stripes_num; ++i) {
+            pmem_fini(&priv->stripes[i]);
+        }
+        jemk_free(priv->stripes);
+    }
 
-    (void) close(priv->fd);
+    if (priv->recovered) {
+        __atomic_fetch_sub(&pmem_recovered_kinds, 1, __ATOMIC_RELAXED);
+    }
+
+    pmem_fini(priv);
     jemk_free(priv);
 
     return 0;
 }
 
-MEMKIND_EXPORT void *memkind_pmem_mmap(struct memkind *kind, void *addr,
-                                       size_t size)
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+
+/*
+ * File on DAX is mapped with MAP_SYNC, so file system metadata is durable
+ * on page fault and flushing CPU caches is enough to make stores durable.
+ */
+static int pmem_mmap_flags(struct memkind_pmem *priv)
 {
-    struct memkind_pmem *priv = kind->priv;
-    void *result;
+    int flags = __atomic_load_n(&priv->mmap_flags, __ATOMIC_RELAXED);
+
+    if (flags == 0 && priv->stripes) {
+        /* CPU cache flush is enough only when every file is on DAX */
+        size_t i;
+        flags = MAP_SHARED_VALIDATE | MAP_SYNC;
+        for (i = 0; i < priv->stripes_num; ++i) {
+            if (!(pmem_mmap_flags(&priv->stripes[i]) & MAP_SYNC)) {
+                flags = MAP_SHARED;
+            }
+        }
+        __atomic_store_n(&priv->mmap_flags, flags, __ATOMIC_RELAXED);
+    } else if (flags == 0) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        void *addr = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED_VALIDATE | MAP_SYNC, priv->fd, 0);
+        if (addr != MAP_FAILED) {
+            (void) munmap(addr, page_size);
+            flags = MAP_SHARED_VALIDATE | MAP_SYNC;
+        } else {
+            flags = MAP_SHARED;
+        }
+        __atomic_store_n(&priv->mmap_flags, flags, __ATOMIC_RELAXED);
+    }
+    return flags;
+}
+
+/*
+ * Grows array pointed by arr, so it can hold at least num elements.
+ * Returns 0 on success, -1 on failure (array is left untouched).
+ */
+static int pmem_array_reserve(void **arr, size_t *cap, size_t num,
+                              size_t elem_size)
+{
+    if (num <= *cap) {
+        return 0;
+    }
+
+    size_t new_cap = *cap ? *cap : 16;
+    while (new_cap < num) {
+        new_cap *= 2;
+    }
+
+    void *new_arr = jemk_realloc(*arr, new_cap * elem_size);
+    if (!new_arr) {
+        log_err("jemk_realloc() failed.");
+        return -1;
+    }
+    *arr = new_arr;
+    *cap = new_cap;
+    return 0;
+}
+
+/*
+ * Marks pages of persistent kind as free or used in the bitmap kept in its
+ * file, so space given back is known after the kind is opened again. Only
+ * pages fully covered by free space are free, pages partially covered by
+ * used space are used. Bitmap is changed under pmem_lock.
+ */
+static void pmem_free_map_set(struct memkind_pmem *priv, off_t offset,
+                              size_t size, bool free)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t *map;
+    size_t first, last, i;
+
+    if (!priv->header) {
+        return;
+    }
+
+    if (free) {
+        first = roundup(offset, page_size) / page_size;
+        last = (offset + size) / page_size;
+    } else {
+        first = offset / page_size;
+        last = roundup(offset + size, page_size) / page_size;
+    }
+    if (first >= last) {
+        return;
+    }
+
+    map = (uint64_t *)((char *)priv->addr + priv->header->free_map);
+    for (i = first; i < last; ++i) {
+        if (free) {
+            map[i / 64] |= 1ull << (i % 64);
+        } else {
+            map[i / 64] &= ~(1ull << (i % 64));
+        }
+    }
+    if (pmem_persist(priv, &map[first / 64],
+                     ((last - 1) / 64 - first / 64 + 1) * sizeof(*map)) != 0) {
+        log_err("Cannot persist bitmap of free pages.");
+    }
+}
+
+/*
+ * Gives file space back to the free ranges, coalescing it with neighbours.
+ * File system blocks of the space are released by punching a hole, or by
+ * truncation when the space is at the end of the file.
+ * Caller must reserve space for one more free range.
+ */
+static void pmem_free_range_put(struct memkind_pmem *priv, off_t offset,
+                                size_t size)
+{
+    struct memkind_pmem_range *ranges = priv->free_ranges;
+    size_t lo = 0, hi = priv->free_ranges_num;
+
+    /* find first range placed after offset */
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ranges[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    bool merge_prev = lo > 0 &&
+                      ranges[lo - 1].offset + (off_t)ranges[lo - 1].size == offset;
+    bool merge_next = lo < priv->free_ranges_num &&
+                      offset + (off_t)size == ranges[lo].offset;
+
+    if (merge_prev && merge_next) {
+        ranges[lo - 1].size += size + ranges[lo].size;
+        memmove(&ranges[lo], &ranges[lo + 1],
+                (priv->free_ranges_num - lo - 1) * sizeof(*ranges));
+        --priv->free_ranges_num;
+    } else if (merge_prev) {
+        ranges[lo - 1].size += size;
+    } else if (merge_next) {
+        ranges[lo].offset = offset;
+        ranges[lo].size += size;
+    } else {
+        memmove(&ranges[lo + 1], &ranges[lo],
+                (priv->free_ranges_num - lo) * sizeof(*ranges));
+        ranges[lo].offset = offset;
+        ranges[lo].size = size;
+        ++priv->free_ranges_num;
+    }
+
+    /*
+     * Last free range touching end of used space shrinks the file. With the
+     * reserved mapping end of used space is moved without the lock, so the
+     * file is never shrunk.
+     */
+    struct memkind_pmem_range *last = &ranges[priv->free_ranges_num - 1];
+    if (!priv->addr && last->offset + (off_t)last->size == priv->offset) {
+        priv->offset = last->offset;
+        --priv->free_ranges_num;
+        if (ftruncate(priv->fd, priv->offset) != 0) {
+            log_err("ftruncate() failed.");
+        }
+    } else if (fallocate(priv->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                         offset, (off_t)size) != 0) {
+        log_err("fallocate() failed to punch a hole.");
+    }
+
+    /* space is marked free only after its blocks are released */
+    pmem_free_map_set(priv, offset, size, true);
+}
+
+/*
+ * Takes len bytes starting at start out of i-th free range, which must
+ * contain them. Caller must reserve space for one more free range.
+ */
+static void pmem_free_range_cut(struct memkind_pmem *priv, size_t i,
+                                off_t start, size_t len)
+{
+    struct memkind_pmem_range *range = &priv->free_ranges[i];
+    size_t head = start - range->offset;
+    size_t tail = range->offset + range->size - (start + len);
+
+    /* space is marked used before it is handed out */
+    pmem_free_map_set(priv, start, len, false);
 
+    if (head && tail) {
+        memmove(range + 2, range + 1,
+                (priv->free_ranges_num - i - 1) * sizeof(*range));
+        range[1].offset = start + (off_t)len;
+        range[1].size = tail;
+        range->size = head;
+        ++priv->free_ranges_num;
+    } else if (head) {
+        range->size = head;
+    } else if (tail) {
+        range->offset = start + (off_t)len;
+        range->size = tail;
+    } else {
+        memmove(range, range + 1,
+                (priv->free_ranges_num - i - 1) * sizeof(*range));
+        --priv->free_ranges_num;
+    }
+}
+
+/*
+ * Takes size bytes of file space from the first free range which is large
+ * enough, so the address of the space is aligned to alignment (offsets are
+ * relative to the reserved mapping, if any). Returns offset of taken space
+ * or -1 when there is no such range.
+ * Caller must reserve space for one more free range.
+ */
+static off_t pmem_free_range_take(struct memkind_pmem *priv, size_t size,
+                                  size_t alignment)
+{
+    uintptr_t base = (uintptr_t)priv->addr;
+    size_t i;
+
+    for (i = 0; i < priv->free_ranges_num; ++i) {
+        struct memkind_pmem_range *range = &priv->free_ranges[i];
+        off_t start = roundup(base + range->offset, alignment) - base;
+        if (start + (off_t)size <= range->offset + (off_t)range->size) {
+            pmem_free_range_cut(priv, i, start, size);
+            return start;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Takes up to size bytes of file space aligned to alignment: from the
+ * first free range which is large enough, otherwise the first aligned piece
+ * of free space, otherwise from the end of the file. Pieces shorter than size
+ * are multiples of the alignment, so the pieces mapped after them stay
+ * aligned too. Returns offset of taken space (its length is stored in taken)
+ * or -1 when kind has no space left.
+ * Caller must reserve space for two more free ranges.
+ */
+static off_t pmem_space_take(struct memkind_pmem *priv, size_t size,
+                             off_t alignment, size_t *taken)
+{
+    off_t offset = pmem_free_range_take(priv, size, alignment);
+    off_t end;
+    size_t i;
+
+    if (offset != -1) {
+        *taken = size;
+        return offset;
+    }
+
+    for (i = 0; i < priv->free_ranges_num; ++i) {
+        struct memkind_pmem_range *range = &priv->free_ranges[i];
+        offset = roundup(range->offset, alignment);
+        end = range->offset + (off_t)range->size;
+        end -= end % alignment;
+        if (offset < end) {
+            *taken = end - offset;
+            pmem_free_range_cut(priv, i, offset, *taken);
+            return offset;
+        }
+    }
+
+    offset = roundup(priv->offset, alignment);
+    if (priv->max_size != 0 && (size_t)offset + size > priv->max_size) {
+        return -1;
+    }
+    /* unaligned space left at the end of the file becomes a free range */
+    end = priv->offset;
+    priv->offset = offset + (off_t)size;
+    if (end < offset) {
+        pmem_free_range_put(priv, end, offset - end);
+    }
+    *taken = size;
+    return offset;
+}
+
+/*
+ * Returns index of the first mapped extent which ends after addr.
+ */
+static size_t pmem_extent_find(struct memkind_pmem *priv, uintptr_t addr)
+{
+    size_t lo = 0, hi = priv->extents_num;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        struct memkind_pmem_extent *extent = &priv->extents[mid];
+        if ((uintptr_t)extent->addr + extent->size <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void pmem_extent_insert(struct memkind_pmem *priv, void *addr,
+                               size_t size, off_t offset)
+{
+    size_t i = pmem_extent_find(priv, (uintptr_t)addr);
+
+    memmove(&priv->extents[i + 1], &priv->extents[i],
+            (priv->extents_num - i) * sizeof(struct memkind_pmem_extent));
+    priv->extents[i].addr = addr;
+    priv->extents[i].size = size;
+    priv->extents[i].offset = offset;
+    ++priv->extents_num;
+}
+
+static int pmem_munmap_locked(struct memkind_pmem *priv, void *addr,
+                              size_t size)
+{
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + size;
+    size_t first, i, count = 0;
+
+    first = pmem_extent_find(priv, start);
+    for (i = first; i < priv->extents_num &&
+         (uintptr_t)priv->extents[i].addr < end; ++i) {
+        ++count;
+    }
+
+    /*
+     * Reserve metadata before anything is unmapped: each extent gives back
+     * one free range and an extent unmapped in the middle is split in two.
+     */
+    if (count == 0 ||
+        pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                           priv->free_ranges_num + count, sizeof(struct memkind_pmem_range)) ||
+        pmem_array_reserve((void **)&priv->extents, &priv->extents_cap,
+                           priv->extents_num + 1, sizeof(struct memkind_pmem_extent))) {
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    if (munmap(addr, size) == -1) {
+        log_err("munmap failed!");
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    i = first;
+    while (i < priv->extents_num && (uintptr_t)priv->extents[i].addr < end) {
+        struct memkind_pmem_extent *extent = &priv->extents[i];
+        uintptr_t ext_start = (uintptr_t)extent->addr;
+        uintptr_t ext_end = ext_start + extent->size;
+        uintptr_t rel_start = ext_start > start ? ext_start : start;
+        uintptr_t rel_end = ext_end < end ? ext_end : end;
+
+        pmem_free_range_put(priv, extent->offset + (off_t)(rel_start - ext_start),
+                            rel_end - rel_start);
+
+        if (rel_start == ext_start && rel_end == ext_end) {
+            memmove(extent, extent + 1,
+                    (priv->extents_num - i - 1) * sizeof(*extent));
+            --priv->extents_num;
+            continue;
+        } else if (rel_start == ext_start) {
+            extent->addr = (void *)rel_end;
+            extent->offset += (off_t)(rel_end - ext_start);
+            extent->size = ext_end - rel_end;
+        } else if (rel_end == ext_end) {
+            extent->size = rel_start - ext_start;
+        } else {
+            memmove(extent + 2, extent + 1,
+                    (priv->extents_num - i - 1) * sizeof(*extent));
+            extent[1].addr = (void *)rel_end;
+            extent[1].size = ext_end - rel_end;
+            extent[1].offset = extent->offset + (off_t)(rel_end - ext_start);
+            extent->size = rel_start - ext_start;
+            ++priv->extents_num;
+        }
+        ++i;
+    }
+
+    return 0;
+}
+
+/*
+ * Carves size bytes out of the reserved mapping. End of used file space is
+ * moved without taking the lock, which is needed only to reuse space given
+ * back by memkind_pmem_munmap() when the kind is full.
+ */
+static void *pmem_mmap_reserved(struct memkind_pmem *priv, size_t size,
+                                size_t alignment, bool *zeroed)
+{
+    uintptr_t base = (uintptr_t)priv->addr;
+    size_t preferred = alignment > priv->alignment ? alignment : priv->alignment;
+    off_t end = __atomic_load_n(&priv->offset, __ATOMIC_RELAXED);
+    off_t offset;
+
+    /*
+     * Space skipped to align the address becomes a free range. When kind is
+     * almost full, the preferred alignment is given up.
+     */
+    do {
+        offset = roundup(base + end, preferred) - base;
+        if ((size_t)offset + size > priv->max_size) {
+            offset = roundup(base + end, alignment) - base;
+        }
+        if ((size_t)offset + size > priv->max_size) {
+            offset = -1;
+            break;
+        }
+    } while (!__atomic_compare_exchange_n(&priv->offset, &end,
+                                          offset + (off_t)size, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (offset != -1 && priv->header) {
+        /*
+         * File must remember used space, it is not known after reopen
+         * otherwise. The header is made durable before the space is handed
+         * out, so after a crash it is never given out again.
+         */
+        uint64_t used = __atomic_load_n(&priv->header->offset, __ATOMIC_RELAXED);
+        while (used < (uint64_t)(offset + size) &&
+               !__atomic_compare_exchange_n(&priv->header->offset, &used,
+                                            offset + size, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        if (pmem_persist(priv, &priv->header->offset,
+                         sizeof(priv->header->offset)) != 0) {
+            return MAP_FAILED;
+        }
+    }
+
+    if (offset != -1 && end < offset) {
+        if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+            assert(0 && "failed to acquire mutex");
+        if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                               priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range)) == 0) {
+            pmem_free_range_put(priv, end, offset - end);
+        }
+        pthread_mutex_unlock(&priv->pmem_lock);
+    }
+
+    /* space never used before is a hole in the file */
+    *zeroed = true;
+
+    if (offset == -1) {
+        if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+            assert(0 && "failed to acquire mutex");
+        if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                               priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range)) == 0) {
+            offset = pmem_free_range_take(priv, size, alignment);
+        }
+        pthread_mutex_unlock(&priv->pmem_lock);
+        if (offset == -1) {
+            return MAP_FAILED;
+        }
+        *zeroed = false;
+    }
+
+    /* allocate file system blocks, so no SIGBUS is raised on first access */
+    if ((errno = posix_fallocate(priv->fd, offset, (off_t)size)) != 0) {
+        if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+            assert(0 && "failed to acquire mutex");
+        if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                               priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range)) == 0) {
+            pmem_free_range_put(priv, offset, size);
+        }
+        pthread_mutex_unlock(&priv->pmem_lock);
+        return MAP_FAILED;
+    }
+
+    return (char *)priv->addr + offset;
+}
+
+static int pmem_munmap_reserved(struct memkind_pmem *priv, void *addr,
+                                size_t size)
+{
+    off_t offset = (char *)addr - (char *)priv->addr;
+    int err = 0;
+
+    if (addr < priv->addr || offset + (off_t)size > (off_t)priv->max_size) {
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    /* address range stays reserved by the kind, only file space is released */
     if (pthread_mutex_lock(&priv->pmem_lock) != 0)
         assert(0 && "failed to acquire mutex");
+    if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                           priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range))) {
+        err = MEMKIND_ERROR_RUNTIME;
+    } else {
+        pmem_free_range_put(priv, offset, size);
+    }
+    pthread_mutex_unlock(&priv->pmem_lock);
 
-    if (priv->max_size != 0 && (size_t)priv->offset + size > priv->max_size) {
-        pthread_mutex_unlock(&priv->pmem_lock);
+    return err;
+}
+
+/*
+ * Reserves address range of size bytes aligned to alignment, which is
+ * replaced by file mappings with MAP_FIXED afterwards.
+ */
+static void *pmem_reserve_aligned(size_t size, size_t alignment)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t len;
+    char *addr, *result;
+
+    size = roundup(size, page_size);
+    len = size + alignment - page_size;
+    addr = mmap(NULL, len, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
         return MAP_FAILED;
     }
 
-    if ((errno = posix_fallocate(priv->fd, priv->offset, (off_t)size)) != 0) {
-        pthread_mutex_unlock(&priv->pmem_lock);
+    result = (char *)roundup((uintptr_t)addr, alignment);
+    if (result != addr) {
+        (void) munmap(addr, result - addr);
+    }
+    if (result + size != addr + len) {
+        (void) munmap(result + size, addr + len - (result + size));
+    }
+    return result;
+}
+
+/*
+ * Maps size bytes at address aligned to alignment. File offsets are aligned
+ * to file_alignment, which must not be larger than alignment.
+ */
+static void *pmem_mmap_locked(struct memkind_pmem *priv, size_t size,
+                              size_t alignment, size_t file_alignment,
+                              bool *zeroed)
+{
+    void *result = MAP_FAILED;
+    size_t mapped = 0, taken;
+    off_t offset, end;
+
+    /*
+     * Every free range and the end of the file can give one piece, taking
+     * a piece can split a free range in two.
+     */
+    if (pmem_array_reserve((void **)&priv->extents, &priv->extents_cap,
+                           priv->extents_num + priv->free_ranges_num + 1,
+                           sizeof(struct memkind_pmem_extent)) ||
+        pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                           2 * priv->free_ranges_num + 3, sizeof(struct memkind_pmem_range))) {
+        return MAP_FAILED;
+    }
+
+    /* recycled file space keeps its previous content */
+    end = priv->offset;
+    offset = pmem_space_take(priv, size, file_alignment, &taken);
+    if (offset == -1) {
         return MAP_FAILED;
     }
+    *zeroed = offset >= end;
+
+    /*
+     * Reserve aligned address range first, when mmap() would not return it,
+     * or when free space is fragmented and file pieces are mapped one after
+     * another. Offset of each piece is aligned like its address, so huge
+     * pages can back the mapping.
+     */
+    if (taken < size || alignment > (size_t)sysconf(_SC_PAGESIZE)) {
+        result = pmem_reserve_aligned(size, alignment);
+        if (result == MAP_FAILED) {
+            pmem_free_range_put(priv, offset, taken);
+            return MAP_FAILED;
+        }
+    }
+
+    while (1) {
+        void *addr = MAP_FAILED;
+        if ((errno = posix_fallocate(priv->fd, offset, (off_t)taken)) == 0) {
+            addr = mmap(result == MAP_FAILED ? NULL : (char *)result + mapped,
+                        taken, PROT_READ | PROT_WRITE,
+                        result == MAP_FAILED ? pmem_mmap_flags(priv) : pmem_mmap_flags(priv) | MAP_FIXED,
+                        priv->fd, offset);
+        }
+        if (addr == MAP_FAILED) {
+            pmem_free_range_put(priv, offset, taken);
+            break;
+        }
+        pmem_extent_insert(priv, addr, taken, offset);
+        if (result == MAP_FAILED) {
+            result = addr;
+        }
+        mapped += taken;
+
+        if (mapped == size) {
+            return result;
+        }
+
+        offset = pmem_space_take(priv, size - mapped, file_alignment, &taken);
+        if (offset == -1) {
+            break;
+        }
+        *zeroed = *zeroed && offset >= end;
+    }
+
+    if (mapped > 0) {
+        (void) pmem_munmap_locked(priv, result, mapped);
+    }
+    if (result != MAP_FAILED && mapped < size) {
+        (void) munmap((char *)result + mapped, size - mapped);
+    }
+    return MAP_FAILED;
+}
+
+static void *pmem_mmap_file(struct memkind_pmem *priv, size_t size,
+                            size_t alignment, bool *zeroed)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    void *result;
+
+    if (alignment < page_size) {
+        alignment = page_size;
+    }
+
+    if (priv->addr) {
+        return pmem_mmap_reserved(priv, size, alignment, zeroed);
+    }
+
+    if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+        assert(0 && "failed to acquire mutex");
 
-    if ((result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, priv->fd,
-                       priv->offset)) != MAP_FAILED) {
-        priv->offset += size;
+    result = pmem_mmap_locked(priv, size,
+                              alignment > priv->alignment ? alignment : priv->alignment,
+                              priv->alignment, zeroed);
+    if (result == MAP_FAILED && priv->alignment > page_size) {
+        /* kind is almost full, give up the preferred alignment */
+        result = pmem_mmap_locked(priv, size, alignment, page_size, zeroed);
     }
 
     pthread_mutex_unlock(&priv->pmem_lock);
@@ -262,8 +1018,991 @@ MEMKIND_EXPORT void *memkind_pmem_mmap(struct memkind *kind, void *addr,
     return result;
 }
 
-MEMKIND_EXPORT int memkind_pmem_get_mmap_flags(struct memkind *kind, int *flags)
+/*
+ * Extents of kind striped across directories are mapped from its files in
+ * turn, so all devices serve the heap. Full file is skipped.
+ */
+static void *pmem_mmap(struct memkind *kind, size_t size, size_t alignment,
+                       bool *zeroed)
 {
-    *flags = MAP_SHARED;
-    return 0;
+    struct memkind_pmem *priv = kind->priv;
+    void *result = MAP_FAILED;
+    size_t first, i;
+
+    if (!priv->stripes) {
+        return pmem_mmap_file(priv, size, alignment, zeroed);
+    }
+
+    first = __atomic_fetch_add(&priv->next_stripe, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < priv->stripes_num && result == MAP_FAILED; ++i) {
+        result = pmem_mmap_file(&priv->stripes[(first + i) % priv->stripes_num],
+                                size, alignment, zeroed);
+    }
+    return result;
+}
+
+/*
+ * Returns index of the file of striped kind which addr is mapped from,
+ * or number of files when addr is not mapped by the kind.
+ */
+static size_t pmem_stripe_find(struct memkind_pmem *priv, void *addr)
+{
+    size_t i;
+
+    for (i = 0; i < priv->stripes_num; ++i) {
+        struct memkind_pmem *stripe = &priv->stripes[i];
+        bool found;
+
+        if (pthread_mutex_lock(&stripe->pmem_lock) != 0)
+            assert(0 && "failed to acquire mutex");
+        size_t j = pmem_extent_find(stripe, (uintptr_t)addr);
+        found = j < stripe->extents_num && stripe->extents[j].addr <= addr;
+        pthread_mutex_unlock(&stripe->pmem_lock);
+
+        if (found) {
+            break;
+        }
+    }
+    return i;
+}
+
+/*
+ * Allocates file system blocks of len bytes mapped at addr. Returns 0 on
+ * success.
+ */
+static int pmem_commit(struct memkind_pmem *priv, void *addr, size_t len)
+{
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + len;
+    size_t i;
+    int err = 0;
+
+    if (priv->stripes) {
+        /* extents are not merged across files */
+        i = pmem_stripe_find(priv, addr);
+        if (i == priv->stripes_num) {
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        priv = &priv->stripes[i];
+    }
+
+    if (priv->addr) {
+        return posix_fallocate(priv->fd, (char *)addr - (char *)priv->addr,
+                               (off_t)len) ? MEMKIND_ERROR_RUNTIME : 0;
+    }
+
+    /* extent of jemalloc can span several mappings of different file parts */
+    if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    for (i = pmem_extent_find(priv, start); !err && i < priv->extents_num &&
+         (uintptr_t)priv->extents[i].addr < end; ++i) {
+        struct memkind_pmem_extent *extent = &priv->extents[i];
+        uintptr_t ext_start = (uintptr_t)extent->addr;
+        uintptr_t ext_end = ext_start + extent->size;
+        uintptr_t part_start = ext_start > start ? ext_start : start;
+        uintptr_t part_end = ext_end < end ? ext_end : end;
+
+        if (posix_fallocate(priv->fd,
+                            extent->offset + (off_t)(part_start - ext_start),
+                            (off_t)(part_end - part_start)) != 0) {
+            err = MEMKIND_ERROR_RUNTIME;
+        }
+    }
+    pthread_mutex_unlock(&priv->pmem_lock);
+
+    return err;
+}
+
+MEMKIND_EXPORT void *memkind_pmem_mmap(struct memkind *kind, void *addr,
+                                       size_t size)
+{
+    bool zeroed;
+
+    return pmem_mmap(kind, size, 0, &zeroed);
+}
+
+MEMKIND_EXPORT int memkind_pmem_munmap(struct memkind *kind, void *addr,
+                                       size_t size)
+{
+    struct memkind_pmem *priv = kind->priv;
+    int err;
+
+    if (priv->addr) {
+        return pmem_munmap_reserved(priv, addr, size);
+    }
+
+    if (priv->stripes) {
+        size_t i = pmem_stripe_find(priv, addr);
+        if (i == priv->stripes_num) {
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        priv = &priv->stripes[i];
+    }
+
+    if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+
+    err = pmem_munmap_locked(priv, addr, size);
+
+    pthread_mutex_unlock(&priv->pmem_lock);
+
+    return err;
+}
+
+MEMKIND_EXPORT int memkind_pmem_get_mmap_flags(struct memkind *kind, int *flags)
+{
+    *flags = MAP_SHARED;
+    return 0;
+}
+
+/*
+ * Maps the whole max_size of the file at once, so extents are carved out of
+ * a single mapping instead of creating a new one for each of them.
+ */
+MEMKIND_EXPORT int memkind_pmem_reserve(struct memkind *kind)
+{
+    struct memkind_pmem *priv = kind->priv;
+
+    if (priv->max_size == 0) {
+        log_err("Cannot reserve mapping for a kind with unlimited size.");
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    void *addr = pmem_reserve_aligned(priv->max_size, priv->alignment);
+    if (addr == MAP_FAILED ||
+        mmap(addr, priv->max_size, PROT_READ | PROT_WRITE,
+             pmem_mmap_flags(priv) | MAP_NORESERVE | MAP_FIXED, priv->fd, 0) == MAP_FAILED) {
+        log_err("mmap() failed.");
+        if (addr != MAP_FAILED) {
+            (void) munmap(addr, priv->max_size);
+        }
+        return MEMKIND_ERROR_MMAP;
+    }
+    priv->addr = addr;
+
+    return 0;
+}
+
+/*
+ * Spreads kind over files opened in different directories, each of them
+ * gets equal part of max_size rounded down to chunks, the last one also the
+ * rest. Files are closed together with the kind.
+ */
+MEMKIND_EXPORT int memkind_pmem_create_stripes(struct memkind *kind,
+                                               const int *fds, size_t num)
+{
+    struct memkind_pmem *priv = kind->priv;
+    size_t part = priv->max_size / num / MEMKIND_PMEM_CHUNK_SIZE *
+                  MEMKIND_PMEM_CHUNK_SIZE;
+    size_t i;
+
+    priv->stripes = jemk_malloc(num * sizeof(struct memkind_pmem));
+    if (!priv->stripes) {
+        log_err("jemk_malloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+
+    for (i = 0; i < num; ++i) {
+        struct memkind_pmem *stripe = &priv->stripes[i];
+        if (pmem_init(stripe) != 0) {
+            while (i--) {
+                priv->stripes[i].fd = -1;
+                pmem_fini(&priv->stripes[i]);
+            }
+            jemk_free(priv->stripes);
+            priv->stripes = NULL;
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        stripe->fd = fds[i];
+        stripe->alignment = priv->alignment;
+        stripe->max_size = i < num - 1 ? part : priv->max_size - (num - 1) * part;
+    }
+    priv->stripes_num = num;
+
+    return 0;
+}
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/*
+ * Takes size bytes aligned to alignment from the beginning of the first
+ * ready piece of memory which is large enough, and wakes up the thread to
+ * prepare more. Returns MAP_FAILED when no piece fits.
+ */
+static void *pmem_prefault_take(struct memkind_pmem_prefault *prefault,
+                                size_t size, size_t alignment, bool *zeroed)
+{
+    void *result = MAP_FAILED;
+    size_t i;
+
+    if (pthread_mutex_lock(&prefault->lock) != 0)
+        assert(0 && "failed to acquire mutex");
+
+    for (i = 0; i < prefault->ready_num; ++i) {
+        struct memkind_pmem_ready *ready = &prefault->ready[i];
+        if (ready->size >= size && ((uintptr_t)ready->addr & (alignment - 1)) == 0) {
+            result = ready->addr;
+            *zeroed = ready->zeroed;
+            ready->addr = (char *)ready->addr + size;
+            ready->size -= size;
+            if (ready->size == 0) {
+                memmove(ready, ready + 1,
+                        (prefault->ready_num - i - 1) * sizeof(*ready));
+                --prefault->ready_num;
+            }
+            prefault->ready_size -= size;
+            prefault->full = false;
+            pthread_cond_signal(&prefault->cond);
+            break;
+        }
+    }
+
+    /*
+     * jemalloc asks for larger and larger extents as the arena grows, so
+     * pieces grow too, to fit the next request. They never grow beyond the
+     * watermark, larger extents are mapped on demand.
+     */
+    if (result == MAP_FAILED && size > prefault->piece) {
+        size_t piece = roundup(2 * size, MEMKIND_PMEM_CHUNK_SIZE);
+        size_t piece_max = roundup(prefault->watermark, MEMKIND_PMEM_CHUNK_SIZE);
+        if (piece > piece_max) {
+            piece = piece_max;
+        }
+        if (piece > prefault->piece) {
+            prefault->piece = piece;
+            prefault->full = false;
+            pthread_cond_signal(&prefault->cond);
+        }
+    }
+
+    pthread_mutex_unlock(&prefault->lock);
+
+    return result;
+}
+
+/*
+ * Gives memory of all ready pieces back to the kind, when it has no space
+ * left for an extent otherwise. Thread does not prepare more until memory
+ * is freed. Returns true when anything was given back.
+ */
+static bool pmem_prefault_release(struct memkind *kind)
+{
+    struct memkind_pmem_prefault *prefault = ((struct memkind_pmem *)
+                                              kind->priv)->prefault;
+    struct memkind_pmem_ready *ready;
+    size_t ready_num, i;
+
+    if (pthread_mutex_lock(&prefault->lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    ready = prefault->ready;
+    ready_num = prefault->ready_num;
+    prefault->ready = NULL;
+    prefault->ready_num = 0;
+    prefault->ready_cap = 0;
+    prefault->ready_size = 0;
+    prefault->full = true;
+    pthread_mutex_unlock(&prefault->lock);
+
+    for (i = 0; i < ready_num; ++i) {
+        (void) memkind_pmem_munmap(kind, ready[i].addr, ready[i].size);
+    }
+    jemk_free(ready);
+
+    return ready_num > 0;
+}
+
+/* lets the thread prepare memory again after space of the kind was freed */
+static void pmem_prefault_wake(struct memkind_pmem_prefault *prefault)
+{
+    if (pthread_mutex_lock(&prefault->lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    if (prefault->full) {
+        prefault->full = false;
+        pthread_cond_signal(&prefault->cond);
+    }
+    pthread_mutex_unlock(&prefault->lock);
+}
+
+static size_t pmem_prefault_largest(struct memkind_pmem_prefault *prefault)
+{
+    size_t largest = 0, i;
+
+    for (i = 0; i < prefault->ready_num; ++i) {
+        if (prefault->ready[i].size > largest) {
+            largest = prefault->ready[i].size;
+        }
+    }
+    return largest;
+}
+
+/*
+ * Keeps watermark bytes of the kind mapped, with file system blocks
+ * allocated and pages faulted in, so extent allocation on the request path
+ * usually neither calls posix_fallocate() nor takes page faults. Memory
+ * left in pieces can be fragmented, so a new piece is also prepared when
+ * none of them could take half of the piece size.
+ */
+static void *pmem_prefault_thread(void *arg)
+{
+    struct memkind *kind = arg;
+    struct memkind_pmem_prefault *prefault = ((struct memkind_pmem *)
+                                              kind->priv)->prefault;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    struct sched_param param = {0};
+
+    /* thread runs only when CPU is not needed by anything else */
+    (void) pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    if (pthread_mutex_lock(&prefault->lock) != 0)
+        assert(0 && "failed to acquire mutex");
+
+    while (!prefault->stop) {
+        if (prefault->full || (prefault->ready_size >= prefault->watermark &&
+                               pmem_prefault_largest(prefault) >= prefault->piece / 2)) {
+            pthread_cond_wait(&prefault->cond, &prefault->lock);
+            continue;
+        }
+        size_t piece = prefault->piece;
+        pthread_mutex_unlock(&prefault->lock);
+
+        bool zeroed;
+        char *addr = pmem_mmap(kind, piece, 0, &zeroed);
+        size_t offset, page;
+        /* short steps, so threads allocating memory are not held up */
+        for (offset = 0; addr != MAP_FAILED && offset < piece;
+             offset += MEMKIND_PMEM_CHUNK_SIZE) {
+            size_t len = piece - offset < MEMKIND_PMEM_CHUNK_SIZE ? piece - offset :
+                         MEMKIND_PMEM_CHUNK_SIZE;
+            if (madvise(addr + offset, len, MADV_POPULATE_WRITE) != 0) {
+                /* kernel older than 5.14, touch every page */
+                for (page = offset; page < offset + len; page += page_size) {
+                    volatile char *p = addr + page;
+                    *p = *p;
+                }
+            }
+            sched_yield();
+        }
+
+        if (pthread_mutex_lock(&prefault->lock) != 0)
+            assert(0 && "failed to acquire mutex");
+        if (addr == MAP_FAILED) {
+            prefault->full = true;
+        } else if (pmem_array_reserve((void **)&prefault->ready, &prefault->ready_cap,
+                                      prefault->ready_num + 1,
+                                      sizeof(struct memkind_pmem_ready))) {
+            pthread_mutex_unlock(&prefault->lock);
+            (void) memkind_pmem_munmap(kind, addr, piece);
+            if (pthread_mutex_lock(&prefault->lock) != 0)
+                assert(0 && "failed to acquire mutex");
+            prefault->full = true;
+        } else {
+            struct memkind_pmem_ready *ready = &prefault->ready[prefault->ready_num++];
+            ready->addr = addr;
+            ready->size = piece;
+            ready->zeroed = zeroed;
+            prefault->ready_size += piece;
+        }
+    }
+
+    pthread_mutex_unlock(&prefault->lock);
+
+    return NULL;
+}
+
+/*
+ * Starts the thread which prepares watermark bytes of memory of the kind in
+ * advance. Memory is prepared in pieces of half of the watermark, extents
+ * which do not fit in them are mapped on demand and make the pieces grow.
+ */
+MEMKIND_EXPORT int memkind_pmem_prefault(struct memkind *kind,
+                                         size_t watermark)
+{
+    struct memkind_pmem *priv = kind->priv;
+    struct memkind_pmem_prefault *prefault;
+
+    prefault = jemk_malloc(sizeof(struct memkind_pmem_prefault));
+    if (!prefault) {
+        log_err("jemk_malloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+
+    prefault->watermark = watermark;
+    prefault->piece = roundup(watermark / 2, MEMKIND_PMEM_CHUNK_SIZE);
+    prefault->ready_size = 0;
+    prefault->full = false;
+    prefault->stop = false;
+    prefault->ready = NULL;
+    prefault->ready_num = 0;
+    prefault->ready_cap = 0;
+
+    if (pthread_mutex_init(&prefault->lock, NULL) != 0) {
+        jemk_free(prefault);
+        return MEMKIND_ERROR_RUNTIME;
+    }
+    if (pthread_cond_init(&prefault->cond, NULL) != 0) {
+        pthread_mutex_destroy(&prefault->lock);
+        jemk_free(prefault);
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    priv->prefault = prefault;
+    if (pthread_create(&prefault->thread, NULL, pmem_prefault_thread,
+                       kind) != 0) {
+        log_err("pthread_create() failed.");
+        priv->prefault = NULL;
+        pthread_cond_destroy(&prefault->cond);
+        pthread_mutex_destroy(&prefault->lock);
+        jemk_free(prefault);
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    return 0;
+}
+
+static void pmem_prefault_stop(struct memkind *kind)
+{
+    struct memkind_pmem *priv = kind->priv;
+    struct memkind_pmem_prefault *prefault = priv->prefault;
+    size_t i;
+
+    if (pthread_mutex_lock(&prefault->lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    prefault->stop = true;
+    pthread_cond_signal(&prefault->cond);
+    pthread_mutex_unlock(&prefault->lock);
+
+    pthread_join(prefault->thread, NULL);
+    priv->prefault = NULL;
+
+    /* memory never given to jemalloc is released here */
+    for (i = 0; i < prefault->ready_num; ++i) {
+        (void) memkind_pmem_munmap(kind, prefault->ready[i].addr,
+                                   prefault->ready[i].size);
+    }
+
+    pthread_cond_destroy(&prefault->cond);
+    pthread_mutex_destroy(&prefault->lock);
+    jemk_free(prefault->ready);
+    jemk_free(prefault);
+}
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/*
+ * Persistent heaps are placed far from addresses used by mmap() and brk(),
+ * so after restart they can be mapped at the same address again.
+ */
+#define PMEM_HEAP_ADDR_MIN (1ull << 44ull) // 16TB
+#define PMEM_HEAP_ADDR_MAX (1ull << 46ull) // 64TB
+#define PMEM_HEAP_ADDR_STEP (1ull << 30ull) // 1GB
+
+static void *pmem_map_heap(struct memkind_pmem *priv, uintptr_t addr)
+{
+    void *result = mmap((void *)addr, priv->max_size, PROT_READ | PROT_WRITE,
+                        pmem_mmap_flags(priv) | MAP_NORESERVE | MAP_FIXED_NOREPLACE, priv->fd, 0);
+
+    /* kernels without MAP_FIXED_NOREPLACE take the address as a hint */
+    if (result != MAP_FAILED && result != (void *)addr) {
+        (void) munmap(result, priv->max_size);
+        result = MAP_FAILED;
+    }
+    return result;
+}
+
+/* bitmap of free pages takes whole pages after the header */
+static size_t pmem_free_map_size(struct memkind_pmem *priv)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    return roundup(roundup(priv->max_size / page_size, 64) / 8, page_size);
+}
+
+/*
+ * Rebuilds free ranges of persistent kind from the bitmap of free pages
+ * kept in its file. Pages used before the kind was opened hold objects not
+ * known to jemalloc, they are remembered until freed by
+ * memkind_pmem_free_recovered().
+ */
+static int pmem_free_map_load(struct memkind_pmem *priv)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t *map = (uint64_t *)((char *)priv->addr +
+                                       priv->header->free_map);
+    size_t first = (priv->header->free_map + pmem_free_map_size(priv)) /
+                   page_size;
+    size_t last = priv->header->offset / page_size;
+    size_t i, start = 0;
+
+    priv->recovered_map = jemk_calloc(roundup(last, 64) / 64, sizeof(uint64_t));
+    if (!priv->recovered_map) {
+        log_err("jemk_calloc() failed.");
+        return MEMKIND_ERROR_MALLOC;
+    }
+
+    /* free pages are coalesced, so each run of them gives one free range */
+    for (i = first; i <= last; ++i) {
+        bool free = i < last && (map[i / 64] & (1ull << (i % 64)));
+        if (free && !start) {
+            start = i;
+        } else if (!free && start) {
+            if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                                   priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range))) {
+                return MEMKIND_ERROR_MALLOC;
+            }
+            priv->free_ranges[priv->free_ranges_num].offset = (off_t)(start * page_size);
+            priv->free_ranges[priv->free_ranges_num].size = (i - start) * page_size;
+            ++priv->free_ranges_num;
+            start = 0;
+        }
+        if (i < last && !free) {
+            priv->recovered_map[i / 64] |= 1ull << (i % 64);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Maps the file of persistent kind. New file gets the header followed by
+ * the bitmap of free pages, existing one is mapped at the address stored in
+ * its header, so pointers kept in the file stay valid. jemalloc metadata is
+ * not kept in the file: space given back before is reused, but objects
+ * allocated before are not known to jemalloc and are released only by
+ * memkind_pmem_free_recovered().
+ */
+MEMKIND_EXPORT int memkind_pmem_open(struct memkind *kind)
+{
+    struct memkind_pmem *priv = kind->priv;
+    struct memkind_pmem_header header;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t map_size = pmem_free_map_size(priv);
+    struct stat st;
+    int err;
+
+    if (fstat(priv->fd, &st) != 0) {
+        log_err("fstat() failed.");
+        return MEMKIND_ERROR_RUNTIME;
+    }
+
+    if (st.st_size == 0) {
+        if ((errno = posix_fallocate(priv->fd, 0, page_size + map_size)) != 0) {
+            log_err("posix_fallocate() failed.");
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        uintptr_t addr = PMEM_HEAP_ADDR_MIN;
+        size_t step = roundup(priv->max_size, PMEM_HEAP_ADDR_STEP);
+        while (addr + priv->max_size <= PMEM_HEAP_ADDR_MAX &&
+               (priv->addr = pmem_map_heap(priv, addr)) == MAP_FAILED) {
+            addr += step;
+        }
+        if (priv->addr == MAP_FAILED) {
+            priv->addr = NULL;
+            log_err("Cannot find address range for pmem heap.");
+            return MEMKIND_ERROR_MMAP;
+        }
+        priv->header = priv->addr;
+        priv->header->version = MEMKIND_PMEM_HEADER_VERSION;
+        priv->header->size = priv->max_size;
+        priv->header->addr = (uintptr_t)priv->addr;
+        priv->header->offset = page_size + map_size;
+        priv->header->root = 0;
+        priv->header->free_map = page_size;
+        /* signature is written last, file without it is not a valid heap */
+        if (msync(priv->header, page_size + map_size, MS_SYNC) != 0) {
+            log_err("msync() failed.");
+            return MEMKIND_ERROR_RUNTIME;
+        }
+        memcpy(priv->header->signature, MEMKIND_PMEM_SIGNATURE,
+               sizeof(MEMKIND_PMEM_SIGNATURE));
+        (void) msync(priv->header, page_size, MS_SYNC);
+    } else {
+        if (pread(priv->fd, &header, sizeof(header), 0) != sizeof(header) ||
+            strncmp(header.signature, MEMKIND_PMEM_SIGNATURE,
+                    sizeof(header.signature)) != 0 ||
+            header.version != MEMKIND_PMEM_HEADER_VERSION) {
+            log_err("File is not a valid pmem heap.");
+            return MEMKIND_ERROR_INVALID;
+        }
+        if (header.size != priv->max_size) {
+            log_err("Size of pmem heap does not match: %zu.", (size_t)header.size);
+            return MEMKIND_ERROR_INVALID;
+        }
+        void *addr = pmem_map_heap(priv, header.addr);
+        if (addr == MAP_FAILED) {
+            log_err("Cannot map pmem heap at its address: %p.", (void *)(uintptr_t)header.addr);
+            return MEMKIND_ERROR_MMAP;
+        }
+        priv->addr = addr;
+        priv->header = addr;
+    }
+
+    err = pmem_free_map_load(priv);
+    if (err) {
+        return err;
+    }
+    priv->offset = priv->header->offset;
+    priv->recovered = priv->header->offset;
+    __atomic_fetch_add(&pmem_recovered_kinds, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+MEMKIND_EXPORT unsigned memkind_pmem_recovered_kinds(void)
+{
+    return __atomic_load_n(&pmem_recovered_kinds, __ATOMIC_RELAXED);
+}
+
+/* objects allocated before the kind was opened are not known to jemalloc */
+MEMKIND_EXPORT bool memkind_pmem_is_recovered(struct memkind *kind,
+                                              const void *ptr)
+{
+    struct memkind_pmem *priv = kind->priv;
+    size_t page;
+
+    if (priv->recovered == 0 || (char *)ptr < (char *)priv->addr ||
+        (char *)ptr >= (char *)priv->addr + priv->recovered) {
+        return false;
+    }
+    page = ((char *)ptr - (char *)priv->addr) / sysconf(_SC_PAGESIZE);
+    return __atomic_load_n(&priv->recovered_map[page / 64], __ATOMIC_RELAXED) &
+           (1ull << (page % 64));
+}
+
+/*
+ * Pages fully covered by the object are given back to the free ranges, so
+ * they are reused when the end of the file is exhausted and are free after
+ * the kind is opened again. Pages shared with other objects stay used.
+ */
+MEMKIND_EXPORT int memkind_pmem_free_recovered(struct memkind *kind, void *ptr,
+                                               size_t size)
+{
+    struct memkind_pmem *priv;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    off_t offset, start, end, run = -1;
+    int err = 0;
+
+    if (!kind || kind->ops != &MEMKIND_PMEM_OPS ||
+        !(priv = kind->priv)->header || !memkind_pmem_is_recovered(kind, ptr)) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    offset = (char *)ptr - (char *)priv->addr;
+    if (size > (size_t)(priv->recovered - offset)) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    start = roundup(offset, page_size);
+    end = (offset + (off_t)size) / page_size * page_size;
+
+    if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    for (; start <= end && !err; start += page_size) {
+        size_t page = start / page_size;
+        bool recovered = start < end &&
+                         (priv->recovered_map[page / 64] & (1ull << (page % 64)));
+        if (recovered) {
+            __atomic_fetch_and(&priv->recovered_map[page / 64],
+                               ~(1ull << (page % 64)), __ATOMIC_RELAXED);
+            if (run == -1) {
+                run = start;
+            }
+        } else if (run != -1) {
+            if (pmem_array_reserve((void **)&priv->free_ranges, &priv->free_ranges_cap,
+                                   priv->free_ranges_num + 1, sizeof(struct memkind_pmem_range))) {
+                err = MEMKIND_ERROR_MALLOC;
+            } else {
+                pmem_free_range_put(priv, run, start - run);
+            }
+            run = -1;
+        }
+    }
+    pthread_mutex_unlock(&priv->pmem_lock);
+
+    return err;
+}
+
+MEMKIND_EXPORT void memkind_pmem_free(struct memkind *kind, void *ptr)
+{
+    if (MEMKIND_UNLIKELY(memkind_pmem_is_recovered(kind, ptr))) {
+        log_err("Cannot free object allocated before the kind was opened, use memkind_pmem_free_recovered().");
+        return;
+    }
+
+    memkind_arena_free(kind, ptr);
+}
+
+MEMKIND_EXPORT void *memkind_pmem_realloc(struct memkind *kind, void *ptr,
+                                          size_t size)
+{
+    if (MEMKIND_UNLIKELY(memkind_pmem_is_recovered(kind, ptr))) {
+        log_err("Cannot reallocate object allocated before the kind was opened.");
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return memkind_arena_realloc(kind, ptr, size);
+}
+
+MEMKIND_EXPORT size_t memkind_pmem_malloc_usable_size(struct memkind *kind,
+                                                      void *ptr)
+{
+    if (MEMKIND_UNLIKELY(memkind_pmem_is_recovered(kind, ptr))) {
+        log_err("Size of object allocated before the kind was opened is not known.");
+        return 0;
+    }
+
+    return memkind_default_malloc_usable_size(kind, ptr);
+}
+
+MEMKIND_EXPORT int memkind_pmem_get_root(struct memkind *kind, void **root)
+{
+    struct memkind_pmem *priv;
+
+    if (!kind || kind->ops != &MEMKIND_PMEM_OPS ||
+        !(priv = kind->priv)->header) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    uint64_t offset = __atomic_load_n(&priv->header->root, __ATOMIC_ACQUIRE);
+    *root = offset ? (char *)priv->addr + offset : NULL;
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_pmem_set_root(struct memkind *kind, void *root)
+{
+    struct memkind_pmem *priv;
+
+    if (!kind || kind->ops != &MEMKIND_PMEM_OPS ||
+        !(priv = kind->priv)->header) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    if (root && ((char *)root < (char *)priv->addr + sizeof(struct memkind_pmem_header) ||
+                 (char *)root >= (char *)priv->addr + priv->max_size)) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    __atomic_store_n(&priv->header->root,
+                     root ? (uint64_t)((char *)root - (char *)priv->addr) : 0,
+                     __ATOMIC_RELEASE);
+    /* root is found after restart only when it reached the media */
+    return pmem_persist(priv, &priv->header->root, sizeof(priv->header->root));
+}
+
+#define PMEM_CACHELINE_SIZE 64
+
+#define CPUID_CLFLUSH_EDX       (1u << 19) // leaf 1
+#define CPUID_CLFLUSHOPT_EBX    (1u << 23) // leaf 7
+#define CPUID_CLWB_EBX          (1u << 24) // leaf 7
+
+static pthread_once_t pmem_flush_once = PTHREAD_ONCE_INIT;
+static bool pmem_flush_available[MEMKIND_PMEM_FLUSH_CLWB + 1];
+static enum memkind_pmem_flush_type pmem_flush_best = MEMKIND_PMEM_FLUSH_MSYNC;
+
+static void pmem_flush_init(void)
+{
+    registers_t registers;
+    int type;
+
+    pmem_flush_available[MEMKIND_PMEM_FLUSH_MSYNC] = true;
+
+    cpuid_asm(0, 0, &registers);
+    uint32_t max_leaf = registers.eax;
+
+    cpuid_asm(1, 0, &registers);
+    pmem_flush_available[MEMKIND_PMEM_FLUSH_CLFLUSH] =
+        registers.edx & CPUID_CLFLUSH_EDX;
+
+    if (max_leaf >= 7) {
+        cpuid_asm(7, 0, &registers);
+        pmem_flush_available[MEMKIND_PMEM_FLUSH_CLFLUSHOPT] =
+            registers.ebx & CPUID_CLFLUSHOPT_EBX;
+        pmem_flush_available[MEMKIND_PMEM_FLUSH_CLWB] =
+            registers.ebx & CPUID_CLWB_EBX;
+    }
+
+    for (type = MEMKIND_PMEM_FLUSH_CLWB; type > MEMKIND_PMEM_FLUSH_MSYNC; --type) {
+        if (pmem_flush_available[type]) {
+            pmem_flush_best = type;
+            break;
+        }
+    }
+}
+
+MEMKIND_EXPORT bool memkind_pmem_flush_type_available(enum memkind_pmem_flush_type
+                                                      type)
+{
+    pthread_once(&pmem_flush_once, pmem_flush_init);
+    return type > MEMKIND_PMEM_FLUSH_AUTO && type <= MEMKIND_PMEM_FLUSH_CLWB &&
+           pmem_flush_available[type];
+}
+
+/*
+ * CPU cache flush makes stores durable only when the file is on DAX,
+ * otherwise page cache has to be written back with msync().
+ */
+static enum memkind_pmem_flush_type pmem_flush_type(struct memkind_pmem *priv)
+{
+    if (MEMKIND_UNLIKELY(priv->flush_type == MEMKIND_PMEM_FLUSH_AUTO)) {
+        pthread_once(&pmem_flush_once, pmem_flush_init);
+        priv->flush_type = pmem_mmap_flags(priv) & MAP_SYNC ? pmem_flush_best :
+                           MEMKIND_PMEM_FLUSH_MSYNC;
+    }
+    return priv->flush_type;
+}
+
+static struct memkind_pmem *pmem_get_priv(struct memkind *kind)
+{
+    return kind && kind->ops == &MEMKIND_PMEM_OPS ? kind->priv : NULL;
+}
+
+static int pmem_flush(struct memkind_pmem *priv, const void *ptr,
+                      size_t len)
+{
+    uintptr_t start = (uintptr_t)ptr & ~(PMEM_CACHELINE_SIZE - 1);
+    uintptr_t end = (uintptr_t)ptr + len;
+    uintptr_t line;
+
+    switch (pmem_flush_type(priv)) {
+        case MEMKIND_PMEM_FLUSH_CLWB:
+            for (line = start; line < end; line += PMEM_CACHELINE_SIZE) {
+                /* clwb, encoded so no special compiler flags are needed */
+                asm volatile(".byte 0x66; xsaveopt %0" : "+m"(*(volatile char *)line));
+            }
+            break;
+        case MEMKIND_PMEM_FLUSH_CLFLUSHOPT:
+            for (line = start; line < end; line += PMEM_CACHELINE_SIZE) {
+                /* clflushopt */
+                asm volatile(".byte 0x66; clflush %0" : "+m"(*(volatile char *)line));
+            }
+            break;
+        case MEMKIND_PMEM_FLUSH_CLFLUSH:
+            for (line = start; line < end; line += PMEM_CACHELINE_SIZE) {
+                asm volatile("clflush %0" : "+m"(*(volatile char *)line));
+            }
+            break;
+        default: {
+            uintptr_t page = (uintptr_t)ptr & ~(sysconf(_SC_PAGESIZE) - 1);
+            if (len && msync((void *)page, end - page, MS_SYNC) != 0) {
+                log_err("msync() failed.");
+                return MEMKIND_ERROR_RUNTIME;
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void pmem_drain(struct memkind_pmem *priv)
+{
+    /* clwb and clflushopt are weakly ordered, msync() has already waited */
+    if (pmem_flush_type(priv) != MEMKIND_PMEM_FLUSH_MSYNC) {
+        asm volatile("sfence" ::: "memory");
+    }
+}
+
+static int pmem_persist(struct memkind_pmem *priv, const void *ptr, size_t len)
+{
+    int err = pmem_flush(priv, ptr, len);
+
+    if (!err) {
+        pmem_drain(priv);
+    }
+    return err;
+}
+
+MEMKIND_EXPORT int memkind_pmem_flush(struct memkind *kind, const void *ptr,
+                                      size_t len)
+{
+    struct memkind_pmem *priv = pmem_get_priv(kind);
+
+    if (!priv) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    return pmem_flush(priv, ptr, len);
+}
+
+MEMKIND_EXPORT int memkind_pmem_drain(struct memkind *kind)
+{
+    struct memkind_pmem *priv = pmem_get_priv(kind);
+
+    if (!priv) {
+        return MEMKIND_ERROR_INVALID;
+    }
+    pmem_drain(priv);
+    return 0;
+}
+
+MEMKIND_EXPORT int memkind_pmem_persist(struct memkind *kind, const void *ptr,
+                                        size_t len)
+{
+    int err = memkind_pmem_flush(kind, ptr, len);
+
+    if (!err) {
+        err = memkind_pmem_drain(kind);
+    }
+    return err;
+}
+
+/*
+ * Finds file offset of ptr in the extents mapped from the file of priv.
+ * Returns 0 on success, -1 when ptr is not mapped from the file.
+ */
+static int pmem_file_offset(struct memkind_pmem *priv, const void *ptr,
+                            off_t *offset)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    int err = -1;
+
+    if (priv->addr) {
+        if (addr >= (uintptr_t)priv->addr &&
+            addr < (uintptr_t)priv->addr + priv->max_size) {
+            *offset = addr - (uintptr_t)priv->addr;
+            err = 0;
+        }
+        return err;
+    }
+
+    if (pthread_mutex_lock(&priv->pmem_lock) != 0)
+        assert(0 && "failed to acquire mutex");
+    size_t i = pmem_extent_find(priv, addr);
+    if (i < priv->extents_num && (uintptr_t)priv->extents[i].addr <= addr) {
+        *offset = priv->extents[i].offset +
+                  (off_t)(addr - (uintptr_t)priv->extents[i].addr);
+        err = 0;
+    }
+    pthread_mutex_unlock(&priv->pmem_lock);
+
+    return err;
+}
+
+MEMKIND_EXPORT int memkind_pmem_get_fd_offset(struct memkind *kind,
+                                              const void *ptr, int *fd, off_t *offset)
+{
+    struct memkind_pmem *priv = pmem_get_priv(kind);
+    size_t i;
+
+    if (!priv) {
+        return MEMKIND_ERROR_INVALID;
+    }
+
+    if (!priv->stripes) {
+        if (pmem_file_offset(priv, ptr, offset) != 0) {
+            return MEMKIND_ERROR_INVALID;
+        }
+        *fd = priv->fd;
+        return 0;
+    }
+
+    for (i = 0; i < priv->stripes_num; ++i) {
+        if (pmem_file_offset(&priv->stripes[i], ptr, offset) == 0) {
+            *fd = priv->stripes[i].fd;
+            return 0;
+        }
+    }
+    return MEMKIND_ERROR_INVALID;
 }
@@ -99,7 +99,9 @@ MEMKIND_EXPORT struct memkind_ops MEMKIND_REGULAR_OPS = {
     .get_mbind_nodemask = memkind_regular_all_get_mbind_nodemask,
     .get_arena = memkind_thread_get_arena,
     .init_once = memkind_regular_init_once,
-    .finalize = memkind_regular_finalize
+    .finalize = memkind_regular_finalize,
+    .malloc_usable_size = memkind_default_malloc_usable_size,
+    .good_size = memkind_default_good_size
 };
 
 
@@ -44,6 +44,7 @@ bool (*pool_free)(void*, void *);
 int (*pool_create_v1)(intptr_t, const struct MemPoolPolicy*, void**);
 bool (*pool_destroy)(void*);
 void* (*pool_identify)(void *object);
+size_t (*pool_msize)(void *, void *);
 
 static void* tbb_handle = NULL;
 
@@ -65,6 +66,8 @@ static int load_tbb_symbols()
                            "_ZN3rml14pool_create_v1ElPKNS_13MemPoolPolicyEPPNS_10MemoryPoolE");
     pool_destroy = dlsym(tbb_handle, "_ZN3rml12pool_destroyEPNS_10MemoryPoolE");
     pool_identify = dlsym(tbb_handle, "_ZN3rml13pool_identifyEPv");
+    // optional, missing in older releases of TBB
+    pool_msize = dlsym(tbb_handle, "_ZN3rml10pool_msizeEPNS_10MemoryPoolEPv");
 
     if(!pool_malloc ||
        !pool_realloc ||
@@ -157,6 +160,11 @@ void tbb_pool_free(struct memkind *kind, void *ptr)
     }
 }
 
+static size_t tbb_pool_usable_size(struct memkind *kind, void *ptr)
+{
+    return ptr ? pool_msize(kind->priv, ptr) : 0;
+}
+
 static int tbb_destroy(struct memkind* kind)
 {
     bool pool_destroy_ret = pool_destroy(kind->priv);
@@ -198,4 +206,7 @@ void tbb_initialize(struct memkind *kind)
     kind->ops->realloc = tbb_pool_realloc;
     kind->ops->free = tbb_pool_free;
     kind->ops->finalize = tbb_destroy;
+    kind->ops->malloc_usable_size = pool_msize ? tbb_pool_usable_size : NULL;
+    // size classes of TBB are not exposed
+    kind->ops->good_size = NULL;
 }
@@ -112,7 +112,19 @@ public:
         if(it != std::end(kind_policy)) {
             return it->second;
         }
-        return -1;
+        // kinds composed by memkind_create_kind() follow the requested policy
+        switch(policy) {
+            case MEMKIND_POLICY_BIND_LOCAL:
+            case MEMKIND_POLICY_BIND_ALL:
+                return MPOL_BIND;
+            case MEMKIND_POLICY_PREFERRED_LOCAL:
+                return MPOL_PREFERRED;
+            case MEMKIND_POLICY_INTERLEAVE_LOCAL:
+            case MEMKIND_POLICY_INTERLEAVE_ALL:
+                return MPOL_INTERLEAVE;
+            default:
+                return -1;
+        }
     }
 
     virtual bool is_high_bandwidth()
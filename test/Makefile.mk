@@ -53,6 +53,7 @@ EXTRA_DIST += test/memkind-afts.ts \
               test/run_alloc_benchmark.sh \
               test/gtest_fused/gtest/gtest-all.cc \
               test/gtest_fused/gtest/gtest.h \
+              test/sysfs \
               # end
 
 
@@ -95,6 +96,9 @@ test_all_tests_SOURCES = $(fused_gtest) \
                          test/static_kinds_tests.cpp \
                          test/hbw_verify_function_test.cpp \
                          test/dlopen_test.cpp \
+                         test/hmat_detection_test.cpp \
+                         test/dax_kmem_test.cpp \
+                         test/memtype_kind_test.cpp \
                          #end
 
 test_locality_test_SOURCES = $(fused_gtest) test/allocator_perf_tool/Allocation_info.cpp test/locality_test.cpp
@@ -163,7 +167,7 @@ test_allocator_perf_tool_tests_SOURCES = $(allocator_perf_tool_library_sources)
 
 
 test_allocator_perf_tool_tests_CPPFLAGS = -Itest/allocator_perf_tool/ -lpthread -lnuma -O0 -Wno-error $(AM_CPPFLAGS)
-test_allocator_perf_tool_tests_CXXFLAGS = -Itest/allocator_perf_tool/ -lpthread -lnuma -O0 -Wno-error $(AM_CPPFLAGS)
+test_allocator_perf_tool_tests_CXXFLAGS = -Itest/allocator_perf_tool/ -lpthread -lnuma -O0 -Wno-error $(AM_CPPFLAGS) -DJE_PREFIX=$(JE_PREFIX)
 
 NUMAKIND_MAX = 2048
 test_all_tests_CXXFLAGS = $(AM_CXXFLAGS) $(CXXFLAGS) $(OPENMP_CFLAGS) -DNUMAKIND_MAX=$(NUMAKIND_MAX) -ldl
@@ -217,6 +221,8 @@ check_PROGRAMS += test/hello_memkind \
                   test/pmem_alignment \
                   test/pmem_multithreads \
                   test/pmem_multithreads_onekind \
+                  test/pmem_multithreads_reserve \
+                  test/pmem_splice \
                   # end
 if HAVE_CXX11
 check_PROGRAMS += test/memkind_allocated
@@ -234,6 +240,8 @@ test_pmem_usable_size_LDADD = libmemkind.la
 test_pmem_alignment_LDADD = libmemkind.la
 test_pmem_multithreads_LDADD = libmemkind.la
 test_pmem_multithreads_onekind_LDADD = libmemkind.la
+test_pmem_multithreads_reserve_LDADD = libmemkind.la
+test_pmem_splice_LDADD = libmemkind.la
 test_autohbw_candidates_LDADD = libmemkind.la \
                                 # end
 if HAVE_CXX11
@@ -251,6 +259,8 @@ test_pmem_usable_size_SOURCES = examples/pmem_usable_size.c
 test_pmem_alignment_SOURCES = examples/pmem_alignment.c
 test_pmem_multithreads_SOURCES = examples/pmem_multithreads.c
 test_pmem_multithreads_onekind_SOURCES = examples/pmem_multithreads_onekind.c
+test_pmem_multithreads_reserve_SOURCES = examples/pmem_multithreads_reserve.c
+test_pmem_splice_SOURCES = examples/pmem_splice.c
 test_autohbw_candidates_SOURCES = examples/autohbw_candidates.c
 test_libautohbw_la_SOURCES = autohbw/autohbw.c
 noinst_LTLIBRARIES += test/libautohbw.la
@@ -28,6 +28,14 @@
 #include "allocator_perf_tool/Thread.hpp"
 #include "allocator_perf_tool/GTestAdapter.hpp"
 
+#include <memkind/internal/memkind_arena.h>
+
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <pthread.h>
+#include <unistd.h>
+
 class AllocPerformanceTest: public :: testing::Test
 {
 private:
@@ -103,6 +111,110 @@ protected:
         GTestAdapter::RecordProperty("ref_delta_time_percent", ref_delta_time_percent);
     }
 
+    // Compare the default tcache limit of kind with a limit covering alloc_size.
+    void run_tcache_test(unsigned kind, size_t threads_number, size_t alloc_size,
+                         unsigned mem_operations_num)
+    {
+        allocator_factory.initialize_allocator(kind);
+        memkind_t memkind = allocator_factory.get_kind_by_type(kind);
+        float default_time = run(kind, FunctionCalls::MALLOC, threads_number,
+                                 alloc_size, mem_operations_num);
+        ASSERT_EQ(0, memkind_set_tcache_max(memkind, alloc_size));
+        float tcache_time = run(kind, FunctionCalls::MALLOC, threads_number,
+                                alloc_size, mem_operations_num);
+        ASSERT_EQ(0, memkind_set_tcache_max(memkind, 4 * KB));
+        float ref_delta_time_percent = allocator_factory.calc_ref_delta(default_time,
+                                                                        tcache_time);
+
+        GTestAdapter::RecordProperty("total_time_spend_on_alloc", default_time);
+        GTestAdapter::RecordProperty("total_time_spend_on_alloc_tcache", tcache_time);
+        GTestAdapter::RecordProperty("alloc_operations_per_thread", mem_operations_num);
+        GTestAdapter::RecordProperty("ref_delta_time_percent", ref_delta_time_percent);
+    }
+
+    struct stats_scraper {
+        memkind_t kind;
+        volatile bool stop;
+    };
+
+    static void *scrape_stats(void *arg)
+    {
+        stats_scraper *scraper = static_cast<stats_scraper *>(arg);
+        memkind_stats_t stats;
+        while (!scraper->stop) {
+            memkind_get_stats(scraper->kind, &stats);
+            usleep(1000);
+        }
+        return nullptr;
+    }
+
+    // Returns time threads spent allocating and freeing mem_operations_num
+    // objects each, summed over the threads.
+    double run_alloc_free(memkind_t kind, void *(*do_malloc)(memkind_t, size_t),
+                          void (*do_free)(memkind_t, void *), size_t threads_number,
+                          size_t alloc_size, unsigned mem_operations_num)
+    {
+        std::vector<std::thread> threads;
+        std::vector<double> times(threads_number);
+
+        for (size_t t = 0; t < threads_number; ++t) {
+            threads.emplace_back([&, t] {
+                std::vector<void *> ptrs(mem_operations_num);
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned i = 0; i < mem_operations_num; ++i) {
+                    ptrs[i] = do_malloc(kind, alloc_size);
+                }
+                for (unsigned i = 0; i < mem_operations_num; ++i) {
+                    do_free(kind, ptrs[i]);
+                }
+                times[t] = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start).count();
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        return std::accumulate(times.begin(), times.end(), 0.0);
+    }
+
+    // Compare allocation time of kind with the same path without per-thread
+    // counters, also while another thread reads its statistics every
+    // millisecond. The difference is recorded, it is within timing noise.
+    void run_stats_test(unsigned kind, size_t threads_number, size_t alloc_size,
+                        unsigned mem_operations_num)
+    {
+        allocator_factory.initialize_allocator(kind);
+        memkind_t memkind = allocator_factory.get_kind_by_type(kind);
+        stats_scraper scraper = {memkind, false};
+        pthread_t thread;
+
+        // first run faults in memory of the kind, it is not measured
+        (void) run_alloc_free(memkind, memkind_arena_malloc_uncounted,
+                              memkind_arena_free_uncounted, threads_number,
+                              alloc_size, mem_operations_num);
+        double ref_time = run_alloc_free(memkind, memkind_arena_malloc_uncounted,
+                                         memkind_arena_free_uncounted, threads_number,
+                                         alloc_size, mem_operations_num);
+        double counted_time = run_alloc_free(memkind, memkind_arena_malloc,
+                                             memkind_arena_free, threads_number,
+                                             alloc_size, mem_operations_num);
+        ASSERT_EQ(0, pthread_create(&thread, nullptr, scrape_stats, &scraper));
+        double stats_time = run_alloc_free(memkind, memkind_arena_malloc,
+                                           memkind_arena_free, threads_number,
+                                           alloc_size, mem_operations_num);
+        scraper.stop = true;
+        ASSERT_EQ(0, pthread_join(thread, nullptr));
+
+        GTestAdapter::RecordProperty("total_time_spend_on_alloc", ref_time);
+        GTestAdapter::RecordProperty("total_time_spend_on_alloc_counted", counted_time);
+        GTestAdapter::RecordProperty("total_time_spend_on_alloc_stats", stats_time);
+        GTestAdapter::RecordProperty("alloc_operations_per_thread", mem_operations_num);
+        GTestAdapter::RecordProperty("ref_delta_time_percent",
+                                     allocator_factory.calc_ref_delta(ref_time, counted_time));
+        GTestAdapter::RecordProperty("ref_delta_time_percent_stats",
+                                     allocator_factory.calc_ref_delta(ref_time, stats_time));
+    }
+
 };
 
 TEST_F(AllocPerformanceTest,
@@ -1954,3 +2066,39 @@ TEST_F(AllocPerformanceTest,
     run_test(AllocatorTypes::HBWMALLOC_ALLOCATOR, FunctionCalls::REALLOC, 72,
              1572864, 10000);
 }
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_REGULAR_malloc_tcache_1_thread_8192_bytes)
+{
+    run_tcache_test(AllocatorTypes::MEMKIND_REGULAR, 1, 8192, 100000);
+}
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_REGULAR_malloc_tcache_1_thread_16384_bytes)
+{
+    run_tcache_test(AllocatorTypes::MEMKIND_REGULAR, 1, 16384, 100000);
+}
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_REGULAR_malloc_tcache_10_thread_16384_bytes)
+{
+    run_tcache_test(AllocatorTypes::MEMKIND_REGULAR, 10, 16384, 10000);
+}
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_HBW_malloc_tcache_10_thread_16384_bytes)
+{
+    run_tcache_test(AllocatorTypes::MEMKIND_HBW, 10, 16384, 10000);
+}
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_REGULAR_malloc_stats_1_thread_100_bytes)
+{
+    run_stats_test(AllocatorTypes::MEMKIND_REGULAR, 1, 100, 100000);
+}
+
+TEST_F(AllocPerformanceTest,
+       test_TC_MEMKIND_MEMKIND_REGULAR_malloc_stats_10_thread_4096_bytes)
+{
+    run_stats_test(AllocatorTypes::MEMKIND_REGULAR, 10, 4096, 10000);
+}
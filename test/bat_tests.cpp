@@ -293,6 +293,18 @@ INSTANTIATE_TEST_CASE_P(DEFAULT,
                         MemtypePolicyTest::get_test_name_suffix
                        );
 
+INSTANTIATE_TEST_CASE_P(DEFAULT_COMPOSED,
+                        MemtypePolicyTest,
+                        ::testing::Combine(::testing::ValuesIn(GetKeys(TestParameters::functions)),
+                                           ::testing::Values(MEMKIND_MEMTYPE_DEFAULT),
+                                           ::testing::Values(MEMKIND_POLICY_BIND_LOCAL,
+                                                             MEMKIND_POLICY_BIND_ALL,
+                                                             MEMKIND_POLICY_INTERLEAVE_ALL),
+                                           ::testing::Values(MEMKIND_MASK_PAGE_SIZE_2MB, memkind_bits_t()),
+                                           ::testing::ValuesIn(TestParameters::sizes)),
+                        MemtypePolicyTest::get_test_name_suffix
+                       );
+
 INSTANTIATE_TEST_CASE_P(HBW,
                         MemtypePolicyTest,
                         ::testing::Combine(::testing::ValuesIn(GetKeys(TestParameters::functions)),
@@ -309,7 +321,8 @@ INSTANTIATE_TEST_CASE_P(HBW_HUGE,
                                            ::testing::Values(MEMKIND_MEMTYPE_HIGH_BANDWIDTH),
                                            ::testing::Values(MEMKIND_POLICY_PREFERRED_LOCAL,
                                                              MEMKIND_POLICY_BIND_LOCAL,
-                                                             MEMKIND_POLICY_BIND_ALL),
+                                                             MEMKIND_POLICY_BIND_ALL,
+                                                             MEMKIND_POLICY_INTERLEAVE_ALL),
                                            ::testing::Values(MEMKIND_MASK_PAGE_SIZE_2MB),
                                            ::testing::ValuesIn(TestParameters::sizes)),
                         MemtypePolicyTest::get_test_name_suffix
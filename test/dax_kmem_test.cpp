@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind.h>
+#include <memkind/internal/memkind_dax_kmem.h>
+#include <memkind/internal/memkind_hbw.h>
+#include <memkind/internal/memkind_private.h>
+
+#include <numa.h>
+#include <numaif.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <climits>
+#include <string>
+
+#include "common.h"
+
+/*
+ * Set of tests for detection of DAX KMEM nodes and kinds using them.
+ * Detection is checked against sysfs trees captured in test/sysfs/<scenario>.
+ */
+
+class DaxKmemTest: public :: testing::Test
+{
+protected:
+    struct bitmask *nodes;
+
+    void SetUp()
+    {
+        nodes = numa_allocate_nodemask();
+    }
+
+    void TearDown()
+    {
+        numa_bitmask_free(nodes);
+        unsetenv("MEMKIND_SYSFS_ROOT");
+        unsetenv("MEMKIND_DAX_KMEM_NODES");
+    }
+
+    void set_scenario(const char *scenario)
+    {
+        std::string path(__FILE__);
+        path = path.substr(0, path.find_last_of('/') + 1) + "sysfs/" + scenario;
+        setenv("MEMKIND_SYSFS_ROOT", path.c_str(), 1);
+    }
+};
+
+TEST_F(DaxKmemTest, test_TC_MEMKIND_DaxKmemNodesSysfs)
+{
+    set_scenario("daxkmem");
+    ASSERT_EQ(0, memkind_dax_kmem_get_nodemask(nodes));
+    // node 2 is backed by device DAX which is not onlined as system RAM
+    ASSERT_EQ(1U, numa_bitmask_weight(nodes));
+    ASSERT_TRUE(numa_bitmask_isbitset(nodes, 1));
+}
+
+TEST_F(DaxKmemTest, test_TC_MEMKIND_DaxKmemNodesNoDevices)
+{
+    set_scenario("hbm");
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE, memkind_dax_kmem_get_nodemask(nodes));
+    ASSERT_EQ(0U, numa_bitmask_weight(nodes));
+}
+
+TEST_F(DaxKmemTest, test_TC_MEMKIND_DaxKmemNodesEnvironment)
+{
+    set_scenario("daxkmem");
+    setenv("MEMKIND_DAX_KMEM_NODES", "0", 1);
+    ASSERT_EQ(0, memkind_dax_kmem_get_nodemask(nodes));
+    ASSERT_EQ(1U, numa_bitmask_weight(nodes));
+    ASSERT_TRUE(numa_bitmask_isbitset(nodes, 0));
+
+    setenv("MEMKIND_DAX_KMEM_NODES", "invalid", 1);
+    ASSERT_EQ(MEMKIND_ERROR_ENVIRON, memkind_dax_kmem_get_nodemask(nodes));
+}
+
+/*
+ * DAX KMEM kinds are available exactly when this machine has DAX KMEM nodes,
+ * memory of DAX KMEM kinds comes from these nodes only.
+ */
+TEST_F(DaxKmemTest, test_TC_MEMKIND_DaxKmemKinds)
+{
+    const size_t size = 4096;
+    memkind_t kinds[] = {MEMKIND_DAX_KMEM, MEMKIND_DAX_KMEM_ALL, MEMKIND_DAX_KMEM_PREFERRED};
+    bool available = memkind_dax_kmem_get_nodemask(nodes) == 0;
+
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i) {
+        if (!available) {
+            ASSERT_NE(0, memkind_check_available(kinds[i]));
+            ASSERT_TRUE(memkind_malloc(kinds[i], size) == NULL);
+            continue;
+        }
+        int node = -1;
+        ASSERT_EQ(0, memkind_check_available(kinds[i]));
+        void *ptr = memkind_malloc(kinds[i], size);
+        ASSERT_TRUE(ptr != NULL);
+        memset(ptr, 0, size);
+        ASSERT_EQ(0, get_mempolicy(&node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR));
+        EXPECT_TRUE(numa_bitmask_isbitset(nodes, node));
+        memkind_free(kinds[i], ptr);
+    }
+}
+
+static int fill_all_nodes(int *values, int values_len)
+{
+    for (int node = 0; node < values_len; ++node) {
+        values[node] = 1;
+    }
+    return 0;
+}
+
+/*
+ * CPU-less DAX KMEM nodes are often equally far from several CPUs. When ties
+ * are allowed, CPUs are bound to all equally close nodes instead of failing.
+ */
+TEST_F(DaxKmemTest, test_TC_MEMKIND_ClosestNumanodeTies)
+{
+    struct memkind_closest_numanode_t g;
+    bool ties = false;
+
+    memkind_closest_numanode_init(&g, fill_all_nodes, "any memory", true);
+    ASSERT_EQ(0, g.init_err);
+    ASSERT_TRUE(g.closest_nodemask_of_node != NULL);
+
+    for (int cpu = 0; cpu < g.num_cpu; ++cpu) {
+        int cpu_node = numa_node_of_cpu(cpu);
+        if (cpu_node < 0) {
+            continue;
+        }
+        int min_distance = INT_MAX;
+        for (int node = 0; node <= numa_max_node(); ++node) {
+            if (numa_bitmask_isbitset(numa_nodes_ptr, node)) {
+                min_distance = std::min(min_distance, numa_distance(cpu_node, node));
+            }
+        }
+        struct bitmask closest;
+        closest.size = NUMA_NUM_NODES;
+        closest.maskp = g.closest_nodemask_of_node[cpu_node].n;
+        for (int node = 0; node <= numa_max_node(); ++node) {
+            bool is_closest = numa_bitmask_isbitset(numa_nodes_ptr, node) &&
+                              numa_distance(cpu_node, node) == min_distance;
+            EXPECT_EQ(is_closest, (bool)numa_bitmask_isbitset(&closest, node));
+        }
+        ties |= numa_bitmask_weight(&closest) > 1;
+    }
+
+    // nodes bound for the calling thread are these of its CPU
+    ASSERT_EQ(0, memkind_closest_numanode_get_mbind_nodemask(&g, nodes->maskp,
+                                                             nodes->size));
+    EXPECT_GE(numa_bitmask_weight(nodes), 1U);
+
+    struct memkind_closest_numanode_t unique;
+    memkind_closest_numanode_init(&unique, fill_all_nodes, "any memory", false);
+    EXPECT_EQ(ties ? MEMKIND_ERROR_RUNTIME : 0, unique.init_err);
+    EXPECT_TRUE(unique.closest_nodemask_of_node == NULL);
+}
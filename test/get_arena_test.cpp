@@ -25,10 +25,16 @@
 #include <memkind/internal/memkind_arena.h>
 
 #include <algorithm>
+#include <climits>
+#include <string>
 #include <vector>
 #include <gtest/gtest.h>
+#include <numa.h>
 #include <omp.h>
 #include <pthread.h>
+#include <sched.h>
+
+extern const char *PMEM_DIR;
 
 class GetArenaTest: public :: testing::Test
 {
@@ -85,3 +91,344 @@ TEST_F(GetArenaTest, test_TC_MEMKIND_ThreadHash)
     EXPECT_LE(max_collisions, collisions_limit);
     RecordProperty("max_collisions", max_collisions);
 }
+
+static void *get_regular_arena(void *arg)
+{
+    unsigned int *arena = static_cast<unsigned int *>(arg);
+    if (memkind_thread_get_arena(MEMKIND_REGULAR, arena, 0) != 0) {
+        *arena = UINT_MAX;
+    }
+    return nullptr;
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_ThreadRoundRobin)
+{
+    memkind_malloc(MEMKIND_REGULAR, 0);
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_ROUND_ROBIN));
+
+    // threads created one after another get consecutive arenas
+    unsigned int arena_num = MEMKIND_REGULAR->arena_map_len;
+    std::vector<unsigned int> arena_idx(arena_num);
+    for (unsigned int i = 0; i < arena_num; ++i) {
+        pthread_t thread;
+        ASSERT_EQ(0, pthread_create(&thread, nullptr, get_regular_arena,
+                                    &arena_idx[i]));
+        ASSERT_EQ(0, pthread_join(thread, nullptr));
+    }
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_HASH));
+
+    std::sort(arena_idx.begin(), arena_idx.end(), uint_comp);
+    EXPECT_TRUE(std::unique(arena_idx.begin(), arena_idx.end()) == arena_idx.end());
+    EXPECT_EQ(arena_idx.end(), std::find(arena_idx.begin(), arena_idx.end(),
+                                         UINT_MAX));
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_ThreadCpu)
+{
+    cpu_set_t cpu_set;
+    unsigned int arena;
+    int cpu = sched_getcpu();
+
+    ASSERT_GE(cpu, 0);
+    memkind_malloc(MEMKIND_REGULAR, 0);
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_CPU));
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    cpu_set_t old_set;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(old_set), &old_set));
+    ASSERT_EQ(0, sched_setaffinity(0, sizeof(cpu_set), &cpu_set));
+    int err = memkind_thread_get_arena(MEMKIND_REGULAR, &arena, 0);
+    sched_setaffinity(0, sizeof(old_set), &old_set);
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_HASH));
+
+    ASSERT_EQ(0, err);
+    EXPECT_EQ(MEMKIND_REGULAR->arena_map[cpu & MEMKIND_REGULAR->arena_map_mask],
+              arena);
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_ThreadNode)
+{
+    cpu_set_t cpu_set, old_set;
+    unsigned int arena;
+    int cpu = sched_getcpu();
+
+    ASSERT_GE(cpu, 0);
+    memkind_malloc(MEMKIND_REGULAR, 0);
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_NODE));
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(old_set), &old_set));
+    ASSERT_EQ(0, sched_setaffinity(0, sizeof(cpu_set), &cpu_set));
+    int err = memkind_thread_get_arena(MEMKIND_REGULAR, &arena, 0);
+    sched_setaffinity(0, sizeof(old_set), &old_set);
+    ASSERT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                          MEMKIND_ARENA_SELECT_HASH));
+    ASSERT_EQ(0, err);
+
+    // the arena lies in the set of slots of the node of the CPU
+    unsigned int nodes = 1;
+    while (nodes < (unsigned int)numa_max_node() + 1) {
+        nodes *= 2;
+    }
+    unsigned int len = MEMKIND_REGULAR->arena_map_len;
+    unsigned int slots = len > nodes ? len / nodes : 1;
+    unsigned int first = (numa_node_of_cpu(cpu) * slots) & MEMKIND_REGULAR->arena_map_mask;
+    EXPECT_NE(MEMKIND_REGULAR->arena_map + first + slots,
+              std::find(MEMKIND_REGULAR->arena_map + first,
+                        MEMKIND_REGULAR->arena_map + first + slots, arena));
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_ArenaSelectInvalid)
+{
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_arena_select(MEMKIND_DEFAULT,
+                                                              MEMKIND_ARENA_SELECT_CPU));
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_arena_select(MEMKIND_REGULAR,
+                                                              static_cast<memkind_arena_select_t>(4)));
+
+    memkind_t kind = nullptr;
+    setenv("MEMKIND_ARENA_SELECT", "random", 1);
+    EXPECT_EQ(MEMKIND_ERROR_ENVIRON, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    setenv("MEMKIND_ARENA_SELECT", "round_robin", 1);
+    int err = memkind_create_pmem(PMEM_DIR, 0, &kind);
+    unsetenv("MEMKIND_ARENA_SELECT");
+    ASSERT_EQ(0, err);
+    EXPECT_EQ(MEMKIND_ARENA_SELECT_ROUND_ROBIN, kind->arena_select);
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_RegionStats)
+{
+    const size_t alloc_size = 2 * 1024 * 1024;
+    memkind_region_stats_t before, after;
+    std::vector<void *> ptrs;
+
+    ASSERT_EQ(0, memkind_get_region_stats(MEMKIND_REGULAR, &before));
+    for (int i = 0; i < 64; ++i) {
+        void *ptr = nullptr;
+        ASSERT_EQ(0, memkind_posix_memalign(MEMKIND_REGULAR, &ptr, alloc_size,
+                                            alloc_size));
+        ptrs.push_back(ptr);
+    }
+    ASSERT_EQ(0, memkind_get_region_stats(MEMKIND_REGULAR, &after));
+    for (void *ptr : ptrs) {
+        memkind_free(MEMKIND_REGULAR, ptr);
+    }
+
+    EXPECT_GT(after.extents, before.extents);
+    EXPECT_LE(after.regions - before.regions, after.extents - before.extents);
+    EXPECT_GT(after.syscalls_saved, before.syscalls_saved);
+
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_get_region_stats(MEMKIND_DEFAULT,
+                                                              &after));
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_get_region_stats(MEMKIND_HUGETLB,
+                                                              &after));
+}
+
+static size_t get_rss_bytes()
+{
+    size_t size = 0, rss = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%zu %zu", &size, &rss) != 2) {
+            rss = 0;
+        }
+        fclose(file);
+    }
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_BackgroundPurge)
+{
+    const size_t alloc_size = 1024 * 1024;
+    const size_t alloc_num = 64;
+    ssize_t dirty_decay_ms = MEMKIND_REGULAR->dirty_decay_ms;
+    ssize_t muzzy_decay_ms = MEMKIND_REGULAR->muzzy_decay_ms;
+    std::vector<void *> ptrs;
+
+    ASSERT_EQ(0, memkind_set_decay(MEMKIND_REGULAR, 100, 0));
+    for (size_t i = 0; i < alloc_num; ++i) {
+        void *ptr = memkind_malloc(MEMKIND_REGULAR, alloc_size);
+        ASSERT_TRUE(ptr != nullptr);
+        memset(ptr, 'a', alloc_size);
+        ptrs.push_back(ptr);
+    }
+    for (void *ptr : ptrs) {
+        memkind_free(MEMKIND_REGULAR, ptr);
+    }
+    size_t freed_rss = get_rss_bytes();
+
+    // nothing allocates in the meantime, only the thread purges
+    ASSERT_EQ(0, memkind_set_background_purge(10));
+    usleep(500000);
+    size_t purged_rss = get_rss_bytes();
+    ASSERT_EQ(0, memkind_set_background_purge(0));
+    ASSERT_EQ(0, memkind_set_decay(MEMKIND_REGULAR, dirty_decay_ms,
+                                   muzzy_decay_ms));
+
+    EXPECT_GE(freed_rss, purged_rss + alloc_size * alloc_num / 2);
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_BackgroundPurgeExtentCache)
+{
+    const size_t alloc_size = 1024 * 1024;
+    const size_t alloc_num = 32;
+    memkind_stats_t cached, expired;
+    std::vector<void *> ptrs;
+
+    ASSERT_EQ(0, memkind_set_extent_cache(MEMKIND_REGULAR, 64 * alloc_size, 100));
+    for (size_t i = 0; i < alloc_num; ++i) {
+        void *ptr = memkind_malloc(MEMKIND_REGULAR, alloc_size);
+        ASSERT_TRUE(ptr != nullptr);
+        ptrs.push_back(ptr);
+    }
+    for (void *ptr : ptrs) {
+        memkind_free(MEMKIND_REGULAR, ptr);
+    }
+    // released extents go to the cache
+    memkind_arena_purge(MEMKIND_REGULAR);
+    ASSERT_EQ(0, memkind_get_stats(MEMKIND_REGULAR, &cached));
+
+    // nothing uses the cache in the meantime, only the thread expires it
+    ASSERT_EQ(0, memkind_set_background_purge(10));
+    usleep(500000);
+    ASSERT_EQ(0, memkind_get_stats(MEMKIND_REGULAR, &expired));
+    ASSERT_EQ(0, memkind_set_background_purge(0));
+    ASSERT_EQ(0, memkind_set_extent_cache(MEMKIND_REGULAR, 64 * 1024 * 1024,
+                                          10000));
+
+    EXPECT_GE(cached.retained, expired.retained + alloc_size * alloc_num / 2);
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_DecayInvalid)
+{
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_decay(MEMKIND_DEFAULT, 0, 0));
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_decay(MEMKIND_REGULAR, -2, 0));
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_decay(MEMKIND_REGULAR, 0, -2));
+
+    memkind_t kind = nullptr;
+    setenv("MEMKIND_DIRTY_DECAY_MS", "-5", 1);
+    EXPECT_EQ(MEMKIND_ERROR_ENVIRON, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    setenv("MEMKIND_DIRTY_DECAY_MS", "250", 1);
+    int err = memkind_create_pmem(PMEM_DIR, 0, &kind);
+    unsetenv("MEMKIND_DIRTY_DECAY_MS");
+    ASSERT_EQ(0, err);
+    EXPECT_EQ(250, kind->dirty_decay_ms);
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_PurgeInvalid)
+{
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_purge(MEMKIND_DEFAULT,
+                                                       MEMKIND_PURGE_FORCED));
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_set_purge(MEMKIND_REGULAR,
+                                                       static_cast<memkind_purge_t>(2)));
+
+    memkind_t kind = nullptr;
+    setenv("MEMKIND_PURGE", "never", 1);
+    EXPECT_EQ(MEMKIND_ERROR_ENVIRON, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    setenv("MEMKIND_PURGE", "forced", 1);
+    int err = memkind_create_pmem(PMEM_DIR, 0, &kind);
+    unsetenv("MEMKIND_PURGE");
+    ASSERT_EQ(0, err);
+    EXPECT_EQ(MEMKIND_PURGE_FORCED, kind->purge);
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+}
+
+static void *alloc_and_exit(void *arg)
+{
+    memkind_t kind = static_cast<memkind_t>(arg);
+    for (int i = 0; i < 10; ++i) {
+        memkind_free(kind, memkind_malloc(kind, 64));
+    }
+    return memkind_malloc(kind, 64);
+}
+
+static void append_output(void *cbopaque, const char *s)
+{
+    static_cast<std::string *>(cbopaque)->append(s);
+}
+
+/*
+ * This test checks that an object above the default tcache_max freed without
+ * its kind is returned to its arena instead of the implicit thread cache.
+ */
+TEST_F(GetArenaTest, test_TC_MEMKIND_FreeNullKindBypassesTcache)
+{
+    const size_t alloc_size = 16 * 1024;
+    memkind_stats_t stats_alloc, stats;
+    memkind_t kind = nullptr;
+
+    ASSERT_EQ(0, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    void *ptr = memkind_malloc(kind, alloc_size);
+    ASSERT_NE(nullptr, ptr);
+    ASSERT_EQ(0, memkind_get_stats(kind, &stats_alloc));
+    memkind_free(nullptr, ptr);
+    ASSERT_EQ(0, memkind_get_stats(kind, &stats));
+    // objects kept in a thread cache are still counted as allocated
+    EXPECT_EQ(stats_alloc.allocated - alloc_size, stats.allocated);
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+}
+
+TEST_F(GetArenaTest, test_TC_MEMKIND_Stats)
+{
+    const size_t alloc_size = 1024 * 1024;
+    const int alloc_num = 16;
+    memkind_stats_t stats, stats_alloc;
+    memkind_t kind = nullptr;
+    void *ptr[alloc_num];
+    pthread_t thread;
+    void *thread_ptr = nullptr;
+
+    EXPECT_EQ(MEMKIND_ERROR_INVALID, memkind_get_stats(MEMKIND_DEFAULT, &stats));
+
+    ASSERT_EQ(0, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    ASSERT_EQ(0, memkind_get_stats(kind, &stats));
+    EXPECT_EQ(0u, stats.nmalloc);
+    EXPECT_EQ(0u, stats.nfree);
+
+    for (int i = 0; i < alloc_num; ++i) {
+        ptr[i] = memkind_malloc(kind, alloc_size);
+        ASSERT_NE(nullptr, ptr[i]);
+    }
+    // counters of threads which have exited are kept
+    ASSERT_EQ(0, pthread_create(&thread, nullptr, alloc_and_exit, kind));
+    ASSERT_EQ(0, pthread_join(thread, &thread_ptr));
+    ASSERT_NE(nullptr, thread_ptr);
+
+    ASSERT_EQ(0, memkind_get_stats(kind, &stats_alloc));
+    EXPECT_EQ(stats.nmalloc + alloc_num + 11, stats_alloc.nmalloc);
+    EXPECT_EQ(stats.nfree + 10, stats_alloc.nfree);
+    EXPECT_GE(stats_alloc.allocated, stats.allocated + alloc_num * alloc_size);
+    EXPECT_GE(stats_alloc.active, stats_alloc.allocated);
+    EXPECT_GE(stats_alloc.mapped, stats_alloc.active);
+
+    std::string output;
+    memkind_stats_print(append_output, &output);
+    EXPECT_NE(std::string::npos, output.find("\"memkind\""));
+    EXPECT_NE(std::string::npos, output.find(std::string("\"name\":\"") +
+                                             kind->name + "\""));
+
+    for (int i = 0; i < alloc_num; ++i) {
+        memkind_free(kind, ptr[i]);
+    }
+    memkind_free(kind, thread_ptr);
+    ASSERT_EQ(0, memkind_get_stats(kind, &stats));
+    EXPECT_EQ(stats_alloc.nfree + alloc_num + 1, stats.nfree);
+    EXPECT_LE(stats.allocated + alloc_num * alloc_size, stats_alloc.allocated);
+
+    // a kind created in the partition of a destroyed one starts from zero
+    unsigned partition = kind->partition;
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+    ASSERT_EQ(0, memkind_create_pmem(PMEM_DIR, 0, &kind));
+    if (kind->partition == partition) {
+        ASSERT_EQ(0, memkind_get_stats(kind, &stats));
+        EXPECT_EQ(0u, stats.nmalloc);
+        EXPECT_EQ(0u, stats.nfree);
+    }
+    EXPECT_EQ(0, memkind_destroy_kind(kind));
+}
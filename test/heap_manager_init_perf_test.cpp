@@ -23,8 +23,12 @@
  */
 #include <sstream>
 #include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "common.h"
+#include "allocator_perf_tool/TimerSysTime.hpp"
 #include "allocator_perf_tool/Configuration.hpp"
 #include "allocator_perf_tool/AllocatorFactory.hpp"
 #include "allocator_perf_tool/HugePageOrganizer.hpp"
@@ -165,3 +169,44 @@ TEST_F(HeapManagerInitPerfTest,
     post_test(stat);
 }
 
+
+static size_t get_rss_bytes()
+{
+    size_t size = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%zu %zu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Kind with an arena per slot of a 224 CPU host (4 * 224 rounded up),
+// only arenas of slots used by threads are created.
+TEST_F(HeapManagerInitPerfTest, test_TC_MEMKIND_perf_libinit_kind_many_arenas)
+{
+    memkind_t kind = nullptr;
+    TimerSysTime timer;
+
+    setenv("MEMKIND_PMEM_ARENA_NUM_PER_KIND", "1024", 1);
+    size_t rss_before = get_rss_bytes();
+    timer.start();
+    int err = memkind_create_pmem("/tmp", 0, &kind);
+    double elapsed_time = timer.getElapsedTime();
+    size_t rss_after = get_rss_bytes();
+    unsetenv("MEMKIND_PMEM_ARENA_NUM_PER_KIND");
+    ASSERT_EQ(0, err);
+
+    void *ptr = memkind_malloc(kind, 100);
+    ASSERT_TRUE(ptr != nullptr);
+    memkind_free(kind, ptr);
+
+    std::stringstream elapsed, rss;
+    elapsed << elapsed_time;
+    rss << (rss_after > rss_before ? rss_after - rss_before : 0);
+    RecordProperty("elapsed_time", elapsed.str());
+    RecordProperty("metadata_rss_bytes", rss.str());
+    ASSERT_EQ(0, memkind_destroy_kind(kind));
+}
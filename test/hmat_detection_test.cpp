@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind.h>
+#include <memkind/internal/memkind_hmat.h>
+#include <memkind/internal/memkind_private.h>
+
+#include <numa.h>
+#include <numaif.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+
+#include "common.h"
+
+/*
+ * Set of tests for detection of memory tiers from sysfs trees captured in
+ * test/sysfs/<scenario>. Paths are derived from location of this file, so
+ * tests have to be run from the directory the library was built in.
+ */
+
+#define HMAT_TEST_NODES 8
+
+class HmatDetectionTest: public :: testing::Test
+{
+protected:
+    int bandwidth[HMAT_TEST_NODES];
+
+    void SetUp()
+    {
+        std::fill(bandwidth, bandwidth + HMAT_TEST_NODES, -1);
+    }
+
+    void TearDown()
+    {
+        unsetenv("MEMKIND_SYSFS_ROOT");
+    }
+
+    void set_scenario(const char *scenario)
+    {
+        std::string path(__FILE__);
+        path = path.substr(0, path.find_last_of('/') + 1) + "sysfs/" + scenario;
+        setenv("MEMKIND_SYSFS_ROOT", path.c_str(), 1);
+    }
+};
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatSysfsRootDefault)
+{
+    ASSERT_STREQ("/sys", memkind_sysfs_root());
+    set_scenario("hbm");
+    ASSERT_STRNE("/sys", memkind_sysfs_root());
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatNodeTopology)
+{
+    set_scenario("hbm");
+    ASSERT_TRUE(memkind_sysfs_node_exists(0));
+    ASSERT_TRUE(memkind_sysfs_node_exists(3));
+    ASSERT_FALSE(memkind_sysfs_node_exists(4));
+    ASSERT_TRUE(memkind_sysfs_node_has_cpus(0));
+    ASSERT_TRUE(memkind_sysfs_node_has_cpus(1));
+    ASSERT_FALSE(memkind_sysfs_node_has_cpus(2));
+    ASSERT_FALSE(memkind_sysfs_node_has_cpus(3));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatGetAttr)
+{
+    unsigned long value = 0;
+
+    set_scenario("hbm");
+    ASSERT_EQ(0, memkind_hmat_get_attr(2, MEMKIND_HMAT_READ_BANDWIDTH, &value));
+    ASSERT_EQ(400000UL, value);
+    ASSERT_EQ(0, memkind_hmat_get_attr(0, MEMKIND_HMAT_READ_LATENCY, &value));
+    ASSERT_EQ(120UL, value);
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE,
+              memkind_hmat_get_attr(4, MEMKIND_HMAT_READ_LATENCY, &value));
+    ASSERT_EQ(MEMKIND_ERROR_INVALID,
+              memkind_hmat_get_attr(0, MEMKIND_HMAT_ATTR_MAX, &value));
+
+    set_scenario("noattr");
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE,
+              memkind_hmat_get_attr(0, MEMKIND_HMAT_READ_BANDWIDTH, &value));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatHbmDetected)
+{
+    set_scenario("hbm");
+    ASSERT_EQ(0, memkind_hmat_fill_bandwidth(bandwidth, HMAT_TEST_NODES));
+    // bandwidth of node is the lower of its read and write bandwidths
+    ASSERT_EQ(90000, bandwidth[0]);
+    ASSERT_EQ(90000, bandwidth[1]);
+    // both HBM nodes are in the top tier despite slightly different values
+    ASSERT_EQ(380000, bandwidth[2]);
+    ASSERT_EQ(380000, bandwidth[3]);
+    for (int node = 4; node < HMAT_TEST_NODES; ++node) {
+        ASSERT_EQ(0, bandwidth[node]);
+    }
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatSlowTierNotHbw)
+{
+    set_scenario("cxl");
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE,
+              memkind_hmat_fill_bandwidth(bandwidth, HMAT_TEST_NODES));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatUniformNotHbw)
+{
+    set_scenario("uniform");
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE,
+              memkind_hmat_fill_bandwidth(bandwidth, HMAT_TEST_NODES));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatNoAttributes)
+{
+    set_scenario("noattr");
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE,
+              memkind_hmat_fill_bandwidth(bandwidth, HMAT_TEST_NODES));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatNodeCapacity)
+{
+    unsigned long long capacity = 0;
+
+    set_scenario("cxl");
+    ASSERT_EQ(0, memkind_sysfs_node_capacity(1, &capacity));
+    ASSERT_EQ(256ULL << 30, capacity);
+    ASSERT_EQ(MEMKIND_ERROR_UNAVAILABLE, memkind_sysfs_node_capacity(2, &capacity));
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatLowestLatency)
+{
+    set_scenario("hbm");
+    ASSERT_EQ(0, memkind_hmat_fill_lowest_latency(bandwidth, HMAT_TEST_NODES));
+    // DRAM is closer to CPUs than HBM
+    ASSERT_EQ(2, bandwidth[0]);
+    ASSERT_EQ(2, bandwidth[1]);
+    ASSERT_EQ(1, bandwidth[2]);
+    ASSERT_EQ(1, bandwidth[3]);
+    ASSERT_EQ(0, bandwidth[4]);
+
+    set_scenario("cxl");
+    ASSERT_EQ(0, memkind_hmat_fill_lowest_latency(bandwidth, HMAT_TEST_NODES));
+    ASSERT_EQ(2, bandwidth[0]);
+    ASSERT_EQ(1, bandwidth[1]);
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatLowestLatencyNoAttributes)
+{
+    // memory of nodes with CPUs is used without latency attributes
+    set_scenario("noattr");
+    ASSERT_EQ(0, memkind_hmat_fill_lowest_latency(bandwidth, HMAT_TEST_NODES));
+    ASSERT_EQ(2, bandwidth[0]);
+    ASSERT_EQ(1, bandwidth[1]);
+    ASSERT_EQ(0, bandwidth[2]);
+}
+
+TEST_F(HmatDetectionTest, test_TC_MEMKIND_HmatHighestCapacity)
+{
+    set_scenario("cxl");
+    ASSERT_EQ(0, memkind_sysfs_fill_highest_capacity(bandwidth, HMAT_TEST_NODES));
+    ASSERT_EQ(1, bandwidth[0]);
+    ASSERT_EQ(2, bandwidth[1]);
+    ASSERT_EQ(0, bandwidth[2]);
+
+    // capacities within 10% are treated alike
+    set_scenario("uniform");
+    ASSERT_EQ(0, memkind_sysfs_fill_highest_capacity(bandwidth, HMAT_TEST_NODES));
+    ASSERT_EQ(2, bandwidth[0]);
+    ASSERT_EQ(2, bandwidth[1]);
+
+    // nodes without memory are skipped
+    set_scenario("noattr");
+    ASSERT_EQ(0, memkind_sysfs_fill_highest_capacity(bandwidth, HMAT_TEST_NODES));
+    ASSERT_EQ(2, bandwidth[0]);
+    ASSERT_EQ(0, bandwidth[1]);
+}
+
+/*
+ * Kinds resolved from attributes of this machine allocate from the node
+ * selected for the CPU of the calling thread.
+ */
+static void check_attribute_kind(memkind_t kind)
+{
+    const size_t size = 4096;
+    int status, node = -1;
+    struct bitmask *kind_nodes = numa_allocate_nodemask();
+
+    ASSERT_EQ(0, memkind_check_available(kind));
+    void *ptr = memkind_malloc(kind, size);
+    ASSERT_TRUE(ptr != NULL);
+    memset(ptr, 0, size);
+    status = get_mempolicy(&node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR);
+    ASSERT_EQ(0, status);
+    ASSERT_EQ(0, kind->ops->get_mbind_nodemask(kind, kind_nodes->maskp,
+                                               kind_nodes->size));
+    EXPECT_TRUE(numa_bitmask_isbitset(kind_nodes, node));
+    memkind_free(kind, ptr);
+    numa_bitmask_free(kind_nodes);
+}
+
+TEST(AttributeKindsTest, test_TC_MEMKIND_LowestLatencyAlloc)
+{
+    check_attribute_kind(MEMKIND_LOWEST_LATENCY);
+}
+
+TEST(AttributeKindsTest, test_TC_MEMKIND_HighestCapacityAlloc)
+{
+    check_attribute_kind(MEMKIND_HIGHEST_CAPACITY);
+}
+
+TEST(AttributeKindsTest, test_TC_MEMKIND_AttributeKindsCreate)
+{
+    memkind_t kind = NULL;
+
+    ASSERT_EQ(MEMKIND_SUCCESS,
+              memkind_create_kind(MEMKIND_MEMTYPE_LOWEST_LATENCY,
+                                  MEMKIND_POLICY_BIND_LOCAL, memkind_bits_t(), &kind));
+    ASSERT_EQ(MEMKIND_LOWEST_LATENCY, kind);
+    ASSERT_EQ(MEMKIND_SUCCESS,
+              memkind_create_kind(MEMKIND_MEMTYPE_HIGHEST_CAPACITY,
+                                  MEMKIND_POLICY_BIND_LOCAL, memkind_bits_t(), &kind));
+    ASSERT_EQ(MEMKIND_HIGHEST_CAPACITY, kind);
+}
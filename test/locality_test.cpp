@@ -24,10 +24,16 @@
 
 #include <stdio.h>
 #include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#include <unistd.h>
 #include <hbwmalloc.h>
 #include <memkind.h>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <iostream>
+#include <cstring>
 #include <gtest/gtest.h>
 #include "allocator_perf_tool/Allocation_info.hpp"
 #include "allocator_perf_tool/GTestAdapter.hpp"
@@ -145,3 +151,172 @@ TEST_F(HBWPreferredLocalityTest,
                                                    std::vector<int> {4, 5, 6, 7});
 }
 
+
+/*
+ * Threads pinned to CPUs of different NUMA nodes allocate from HBW kinds,
+ * which select arenas by node, and check with move_pages() that pages land
+ * on the HBW node closest to their own node even when memory of the kind
+ * was used by threads of other nodes before.
+ */
+class HBWNodeArenaLocalityTest: public ::testing::Test
+{
+protected:
+    std::vector<int> node_cpus; // one CPU of each node with CPUs
+    std::vector<int> hbw_nodes;
+
+    void SetUp()
+    {
+        if (numa_available() || hbw_check_available()) {
+            return;
+        }
+        const char *hbw_nodes_env = getenv("MEMKIND_HBW_NODES");
+        struct bitmask *cpus = numa_allocate_cpumask();
+        for (int node = 0; node <= numa_max_node(); node++) {
+            if (numa_node_to_cpus(node, cpus) || numa_bitmask_weight(cpus) == 0) {
+                // high bandwidth memory is exposed as nodes without CPUs
+                if (!hbw_nodes_env && numa_node_size64(node, nullptr) > 0) {
+                    hbw_nodes.push_back(node);
+                }
+                continue;
+            }
+            for (unsigned cpu = 0; cpu < cpus->size; cpu++) {
+                if (numa_bitmask_isbitset(cpus, cpu)) {
+                    node_cpus.push_back(cpu);
+                    break;
+                }
+            }
+        }
+        numa_free_cpumask(cpus);
+        if (hbw_nodes_env) {
+            struct bitmask *nodes = numa_parse_nodestring(hbw_nodes_env);
+            for (int node = 0; nodes && node <= numa_max_node(); node++) {
+                if (numa_bitmask_isbitset(nodes, node)) {
+                    hbw_nodes.push_back(node);
+                }
+            }
+            if (nodes) {
+                numa_free_nodemask(nodes);
+            }
+        }
+    }
+
+    bool topology_supported()
+    {
+        if (node_cpus.size() < 2 || hbw_nodes.empty()) {
+            std::cout << "[ SKIPPED ] Requires HBW and at least 2 nodes with CPUs"
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static bool pin_to_cpu(int cpu_id)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu_id, &cpu_set);
+        return sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) != -1;
+    }
+
+    int closest_hbw_node(int cpu_id)
+    {
+        int node = numa_node_of_cpu(cpu_id);
+        int min_distance = 0;
+        int closest_node = -1;
+        for (int hbw_node : hbw_nodes) {
+            int distance = numa_distance(node, hbw_node);
+            if (distance && (distance < min_distance || min_distance == 0)) {
+                min_distance = distance;
+                closest_node = hbw_node;
+            }
+        }
+        return closest_node;
+    }
+
+    static int page_node(void *ptr)
+    {
+        void *page = (void *)((uintptr_t)ptr & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1));
+        int status = -1;
+        if (move_pages(0, 1, &page, nullptr, &status, 0)) {
+            return -1;
+        }
+        return status;
+    }
+
+    // Allocates objects of size from kind on cpu_id and checks their pages.
+    void alloc_and_check(memkind_t kind, int cpu_id, size_t size, size_t num,
+                         std::vector<void *> &ptrs)
+    {
+        int expected_node = closest_hbw_node(cpu_id);
+        for (size_t i = 0; i < num; i++) {
+            void *ptr = memkind_malloc(kind, size);
+            ASSERT_NE(nullptr, ptr);
+            memset(ptr, 1, size);
+            EXPECT_EQ(expected_node, page_node(ptr)) << "cpu " << cpu_id;
+            ptrs.push_back(ptr);
+        }
+    }
+
+    void run_threads_on_nodes(memkind_t kind, size_t size, size_t num)
+    {
+        std::vector<void *> ptrs;
+
+        // memory released by threads of one node must not serve other nodes
+        for (int cpu_id : node_cpus) {
+            std::thread thread([&] {
+                ASSERT_TRUE(pin_to_cpu(cpu_id));
+                alloc_and_check(kind, cpu_id, size, num, ptrs);
+                for (void *ptr : ptrs) {
+                    memkind_free(kind, ptr);
+                }
+                ptrs.clear();
+            });
+            thread.join();
+        }
+    }
+
+    void run_migrating_thread(memkind_t kind, size_t size, size_t num)
+    {
+        std::vector<void *> ptrs;
+
+        std::thread thread([&] {
+            for (int cpu_id : node_cpus) {
+                ASSERT_TRUE(pin_to_cpu(cpu_id));
+                alloc_and_check(kind, cpu_id, size, num, ptrs);
+            }
+        });
+        thread.join();
+        for (void *ptr : ptrs) {
+            memkind_free(kind, ptr);
+        }
+    }
+};
+
+TEST_F(HBWNodeArenaLocalityTest, test_TC_MEMKIND_threads_on_nodes_100_bytes)
+{
+    if (topology_supported()) {
+        run_threads_on_nodes(MEMKIND_HBW, 100, 1000);
+    }
+}
+
+TEST_F(HBWNodeArenaLocalityTest, test_TC_MEMKIND_threads_on_nodes_1_MB)
+{
+    if (topology_supported()) {
+        run_threads_on_nodes(MEMKIND_HBW, 1024 * 1024, 16);
+    }
+}
+
+TEST_F(HBWNodeArenaLocalityTest, test_TC_MEMKIND_migrating_thread_100_bytes)
+{
+    if (topology_supported()) {
+        run_migrating_thread(MEMKIND_HBW, 100, 150);
+    }
+}
+
+TEST_F(HBWNodeArenaLocalityTest,
+       test_TC_MEMKIND_PREFERRED_migrating_thread_100_bytes)
+{
+    if (topology_supported()) {
+        run_migrating_thread(MEMKIND_HBW_PREFERRED, 100, 150);
+    }
+}
@@ -29,6 +29,7 @@
 #include "allocator_perf_tool/Allocation_info.hpp"
 
 #include <memkind.h>
+#include <memkind/internal/memkind_arena.h>
 
 #include <condition_variable>
 #include <functional>
@@ -218,9 +219,82 @@ void run_test(memkind_t kind, size_t min_size, size_t max_size,
     mem_footprint_stats.log_data();
 }
 
+static void alloc_burst(memkind_t kind, size_t alloc_size, size_t alloc_num,
+                        std::vector<void *> &ptrs)
+{
+    for (size_t i = 0; i < alloc_num; ++i) {
+        void *ptr = memkind_malloc(kind, alloc_size);
+        ASSERT_TRUE(ptr != nullptr);
+        memset(ptr, 'a', alloc_size);
+        ptrs.push_back(ptr);
+    }
+}
+
+static void free_burst(memkind_t kind, std::vector<void *> &ptrs)
+{
+    for (void *ptr : ptrs) {
+        memkind_free(kind, ptr);
+    }
+    ptrs.clear();
+    memkind_arena_purge(kind);
+}
+
+/*
+ * Allocate a burst of memory, free it and check that address space of kind
+ * is kept by the extent cache up to its limit and unmapped after decay.
+ */
+void run_burst_test(memkind_t kind)
+{
+    const size_t alloc_size = 4 * MB;
+    const size_t alloc_num = 64;
+    const size_t cache_max = 64 * MB;
+    const size_t slack = 16 * MB;
+    ProcStat proc_stat;
+    std::vector<void *> ptrs;
+
+    if (memkind_check_available(kind)) {
+        return;
+    }
+    ASSERT_EQ(0, memkind_set_extent_cache(kind, cache_max, 3600 * 1000));
+    memkind_arena_purge(kind);
+    long long initial_vm = proc_stat.get_virtual_memory_size_bytes();
+
+    alloc_burst(kind, alloc_size, alloc_num, ptrs);
+    long long peak_vm = proc_stat.get_virtual_memory_size_bytes();
+    free_burst(kind, ptrs);
+    long long cached_vm = proc_stat.get_virtual_memory_size_bytes();
+
+    // decay of 0 unmaps whole cache
+    ASSERT_EQ(0, memkind_set_extent_cache(kind, cache_max, 0));
+    long long released_vm = proc_stat.get_virtual_memory_size_bytes();
+    ASSERT_EQ(0, memkind_set_extent_cache(kind, cache_max, 10000));
+
+    // jemalloc keeps remainders of extents it grows, only the rest is cached
+    EXPECT_LE(cached_vm - released_vm, (long long)(cache_max + slack));
+    EXPECT_GT(cached_vm, released_vm);
+    EXPECT_LT(released_vm - initial_vm, (peak_vm - initial_vm) / 2);
+
+    GTestAdapter::RecordProperty("peak_vm_overhead_mb",
+                                 convert_bytes_to_mb(peak_vm - initial_vm));
+    GTestAdapter::RecordProperty("cached_vm_overhead_mb",
+                                 convert_bytes_to_mb(cached_vm - initial_vm));
+    GTestAdapter::RecordProperty("released_vm_overhead_mb",
+                                 convert_bytes_to_mb(released_vm - initial_vm));
+}
+
 class MemoryFootprintTest: public :: testing::Test
 {};
 
+TEST_F(MemoryFootprintTest, test_TC_MEMKIND_HBW_burst_release)
+{
+    run_burst_test(MEMKIND_HBW);
+}
+
+TEST_F(MemoryFootprintTest, test_TC_MEMKIND_REGULAR_burst_release)
+{
+    run_burst_test(MEMKIND_REGULAR);
+}
+
 TEST_F(MemoryFootprintTest,
        test_TC_MEMKIND_DEFAULT_only_malloc_small_allocations_1_thread)
 {
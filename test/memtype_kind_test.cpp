@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018 Intel Corporation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice(s),
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice(s),
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDER(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memkind.h>
+#include <memkind/internal/memkind_private.h>
+
+#include <numa.h>
+#include <numaif.h>
+
+#include "common.h"
+
+/*
+ * Set of tests for kinds which memkind_create_kind() composes for memory
+ * types, policy and flags without a static kind.
+ */
+
+static const memkind_memtype_t memtypes[] = {
+    MEMKIND_MEMTYPE_DEFAULT,
+    MEMKIND_MEMTYPE_HIGH_BANDWIDTH,
+    MEMKIND_MEMTYPE_LOWEST_LATENCY,
+    MEMKIND_MEMTYPE_HIGHEST_CAPACITY
+};
+
+#define MEMTYPES_NUM (sizeof(memtypes) / sizeof(memtypes[0]))
+
+class MemtypeKindTest: public :: testing::Test
+{
+protected:
+    memkind_memtype_t get_memtype_flags(unsigned mask)
+    {
+        int flags = 0;
+        for (unsigned i = 0; i < MEMTYPES_NUM; ++i) {
+            if (mask & (1U << i)) {
+                flags |= memtypes[i];
+            }
+        }
+        return (memkind_memtype_t)flags;
+    }
+
+    int get_mbind_mode(memkind_policy_t policy)
+    {
+        switch (policy) {
+            case MEMKIND_POLICY_PREFERRED_LOCAL:
+                return MPOL_PREFERRED;
+            case MEMKIND_POLICY_INTERLEAVE_LOCAL:
+            case MEMKIND_POLICY_INTERLEAVE_ALL:
+                return MPOL_INTERLEAVE;
+            default:
+                return MPOL_BIND;
+        }
+    }
+
+    bool is_local(memkind_policy_t policy)
+    {
+        return policy == MEMKIND_POLICY_BIND_LOCAL ||
+               policy == MEMKIND_POLICY_PREFERRED_LOCAL ||
+               policy == MEMKIND_POLICY_INTERLEAVE_LOCAL;
+    }
+
+    // Allocates from kind and checks the policy of the pages.
+    void check_allocation(memkind_t kind, memkind_policy_t policy)
+    {
+        const size_t size = 4096;
+        int mode = -1, node = -1;
+        void *ptr = memkind_malloc(kind, size);
+        ASSERT_TRUE(ptr != NULL);
+        memset(ptr, 0, size);
+        ASSERT_EQ(0, get_mempolicy(&mode, NULL, 0, ptr, MPOL_F_ADDR));
+        EXPECT_EQ(get_mbind_mode(policy), mode);
+        ASSERT_EQ(0, get_mempolicy(&node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR));
+        // nodes of local policies follow the CPU, which may change meanwhile
+        if (!is_local(policy)) {
+            struct bitmask *nodes = numa_allocate_nodemask();
+            ASSERT_EQ(0, kind->ops->get_mbind_nodemask(kind, nodes->maskp,
+                                                       nodes->size));
+            EXPECT_TRUE(numa_bitmask_isbitset(nodes, node));
+            numa_bitmask_free(nodes);
+        }
+        memkind_free(kind, ptr);
+    }
+};
+
+/*
+ * Every valid combination of memory types and policy creates a kind, unless
+ * the memory type is not available on this machine.
+ */
+TEST_F(MemtypeKindTest, test_TC_MEMKIND_MemtypeKindAllCombinations)
+{
+    for (unsigned mask = 1; mask < (1U << MEMTYPES_NUM); ++mask) {
+        memkind_memtype_t memtype_flags = get_memtype_flags(mask);
+        for (int p = 0; p < MEMKIND_POLICY_MAX_VALUE; ++p) {
+            memkind_policy_t policy = (memkind_policy_t)p;
+            memkind_t kind = NULL;
+            int ret = memkind_create_kind(memtype_flags, policy, memkind_bits_t(),
+                                          &kind);
+            if (policy == MEMKIND_POLICY_PREFERRED_LOCAL && (mask & (mask - 1))) {
+                ASSERT_EQ(MEMKIND_ERROR_INVALID, ret);
+                continue;
+            }
+            if (ret == MEMKIND_ERROR_MEMTYPE_NOT_AVAILABLE) {
+                continue;
+            }
+            ASSERT_EQ(MEMKIND_SUCCESS, ret) << "memtype " << memtype_flags <<
+                                            " policy " << policy;
+            ASSERT_TRUE(kind != NULL);
+            // preferred policy falls back to MEMKIND_DEFAULT
+            if (kind == MEMKIND_DEFAULT) {
+                continue;
+            }
+            check_allocation(kind, policy);
+            ASSERT_EQ(MEMKIND_SUCCESS, memkind_destroy_kind(kind));
+        }
+    }
+}
+
+TEST_F(MemtypeKindTest, test_TC_MEMKIND_MemtypeKindDefaultBindLocal)
+{
+    memkind_t kind = NULL;
+    int ret = memkind_create_kind(MEMKIND_MEMTYPE_DEFAULT,
+                                  MEMKIND_POLICY_BIND_LOCAL, memkind_bits_t(),
+                                  &kind);
+    ASSERT_EQ(MEMKIND_SUCCESS, ret);
+    ASSERT_GE(kind->partition, (unsigned)MEMKIND_NUM_BASE_KIND);
+    ASSERT_EQ(MEMKIND_ARENA_SELECT_NODE, kind->arena_select);
+    check_allocation(kind, MEMKIND_POLICY_BIND_LOCAL);
+    ASSERT_EQ(MEMKIND_SUCCESS, memkind_destroy_kind(kind));
+}
+
+/*
+ * Kind is created once for a combination and shared by all callers, so
+ * creating it repeatedly does not use up the registry of kinds and destroying
+ * it does nothing.
+ */
+TEST_F(MemtypeKindTest, test_TC_MEMKIND_MemtypeKindCached)
+{
+    memkind_t kind1 = NULL, kind2 = NULL;
+    ASSERT_EQ(MEMKIND_SUCCESS, memkind_create_kind(MEMKIND_MEMTYPE_DEFAULT,
+                                                   MEMKIND_POLICY_INTERLEAVE_ALL,
+                                                   memkind_bits_t(), &kind1));
+    ASSERT_GE(kind1->partition, (unsigned)MEMKIND_NUM_BASE_KIND);
+    for (int i = 0; i < 2 * MEMKIND_MAX_KIND; ++i) {
+        ASSERT_EQ(MEMKIND_SUCCESS, memkind_create_kind(MEMKIND_MEMTYPE_DEFAULT,
+                                                       MEMKIND_POLICY_INTERLEAVE_ALL,
+                                                       memkind_bits_t(), &kind2));
+        ASSERT_EQ(kind1, kind2);
+        ASSERT_EQ(MEMKIND_SUCCESS, memkind_destroy_kind(kind2));
+    }
+    check_allocation(kind1, MEMKIND_POLICY_INTERLEAVE_ALL);
+
+    // static kinds are not destroyed either
+    ASSERT_EQ(MEMKIND_SUCCESS, memkind_destroy_kind(MEMKIND_DEFAULT));
+    void *ptr = memkind_malloc(MEMKIND_DEFAULT, 64);
+    ASSERT_TRUE(ptr != NULL);
+    memkind_free(MEMKIND_DEFAULT, ptr);
+}
+
+/*
+ * Interleaved kind with 2MB pages is available when huge pages of the local
+ * node are, as it interleaves over the local node too.
+ */
+TEST_F(MemtypeKindTest, test_TC_MEMKIND_MemtypeKindInterleavePageSize2MB)
+{
+    memkind_t kind = NULL;
+    int ret = memkind_create_kind(MEMKIND_MEMTYPE_DEFAULT,
+                                  MEMKIND_POLICY_INTERLEAVE_ALL,
+                                  MEMKIND_MASK_PAGE_SIZE_2MB, &kind);
+    if (ret == MEMKIND_ERROR_MEMTYPE_NOT_AVAILABLE) {
+        ASSERT_NE(0, memkind_check_available(MEMKIND_HUGETLB));
+        return;
+    }
+    ASSERT_EQ(MEMKIND_SUCCESS, ret);
+    ASSERT_EQ(MEMKIND_SUCCESS, memkind_destroy_kind(kind));
+}
@@ -23,8 +23,16 @@
 */
 
 #include "perf_tests.hpp"
+#include <memkind/internal/memkind_private.h>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <sys/resource.h>
 #include <gtest/gtest.h>
 
 // Memkind performance tests
@@ -33,6 +41,8 @@ using std::endl;
 using std::abs;
 using std::ostringstream;
 
+extern const char *PMEM_DIR;
+
 // Memkind tests
 class PerformanceTest : public testing::Test
 {
@@ -160,3 +170,199 @@ TEST_F(PerformanceTest, test_TC_MEMKIND_perf_many_ops_many_iters_many_kinds)
     performanceTest.setupTest_manyOpsManyIters();
     run();
 }
+
+// Measures latency of allocating and first writing to memory of PMEM kind
+// with and without memory prepared in advance by the prefault thread
+class PmemPrefaultPerformanceTest : public testing::Test
+{
+protected:
+    const size_t allocSize = 256 * 1024;
+    const size_t allocNum = 256;
+
+    std::vector<double> measure(const char *prefault)
+    {
+        std::vector<double> latencies;
+        std::vector<void *> ptrs;
+        memkind_t kind = nullptr;
+
+        if (prefault) {
+            setenv("MEMKIND_PMEM_PREFAULT", prefault, 1);
+        }
+        int err = memkind_create_pmem(PMEM_DIR, 0, &kind);
+        unsetenv("MEMKIND_PMEM_PREFAULT");
+        if (err) {
+            ADD_FAILURE() << "memkind_create_pmem() failed: " << err;
+            return latencies;
+        }
+
+        for (size_t i = 0; i < allocNum; ++i) {
+            // requests arrive with gaps, in which the thread refills memory
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            auto start = std::chrono::steady_clock::now();
+            char *ptr = static_cast<char *>(memkind_malloc(kind, allocSize));
+            if (!ptr) {
+                break;
+            }
+            memset(ptr, 'a', allocSize);
+            auto end = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::micro>
+                                (end - start).count());
+            ptrs.push_back(ptr);
+        }
+
+        for (void *ptr : ptrs) {
+            memkind_free(kind, ptr);
+        }
+        EXPECT_EQ(0, memkind_destroy_kind(kind));
+        EXPECT_EQ(allocNum, latencies.size());
+        std::sort(latencies.begin(), latencies.end());
+        return latencies;
+    }
+
+    void record(const string &prefix, const std::vector<double> &latencies)
+    {
+        if (latencies.empty()) {
+            return;
+        }
+        ostringstream p50, p99, max;
+        p50 << latencies[latencies.size() / 2];
+        p99 << latencies[latencies.size() * 99 / 100];
+        max << latencies.back();
+        RecordProperty(prefix + "_p50_usec", p50.str());
+        RecordProperty(prefix + "_p99_usec", p99.str());
+        RecordProperty(prefix + "_max_usec", max.str());
+        cout << prefix << ": p50 " << p50.str() << " usec, p99 " << p99.str() <<
+             " usec, max " << max.str() << " usec" << endl;
+    }
+};
+
+TEST_F(PmemPrefaultPerformanceTest, test_TC_MEMKIND_perf_pmem_prefault_latency)
+{
+    record("on_demand", measure(nullptr));
+    record("prefault", measure("16777216"));
+}
+
+// Measures throughput of threads contending for arenas of a kind
+// with each arena selection strategy
+class ArenaSelectPerformanceTest : public testing::Test
+{
+protected:
+    const size_t allocSize = 8 * 1024; // above tcache_max, takes the arena lock
+    const size_t opsPerThread = 20000;
+    const size_t window = 16;
+
+    double measure(memkind_arena_select_t select, size_t threadsNum)
+    {
+        std::atomic<bool> start(false);
+        std::vector<std::thread> threads;
+
+        EXPECT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR, select));
+        for (size_t t = 0; t < threadsNum; ++t) {
+            threads.emplace_back([&]() {
+                std::vector<void *> ptrs(window, nullptr);
+                while (!start.load()) {
+                    std::this_thread::yield();
+                }
+                for (size_t i = 0; i < opsPerThread; ++i) {
+                    size_t slot = i % window;
+                    memkind_free(MEMKIND_REGULAR, ptrs[slot]);
+                    ptrs[slot] = memkind_malloc(MEMKIND_REGULAR, allocSize);
+                }
+                for (void *ptr : ptrs) {
+                    memkind_free(MEMKIND_REGULAR, ptr);
+                }
+            });
+        }
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        EXPECT_EQ(0, memkind_set_arena_select(MEMKIND_REGULAR,
+                                              MEMKIND_ARENA_SELECT_HASH));
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        return threadsNum * opsPerThread / seconds;
+    }
+};
+
+TEST_F(ArenaSelectPerformanceTest, test_TC_MEMKIND_perf_arena_select_contention)
+{
+    const struct {
+        memkind_arena_select_t select;
+        const char *name;
+    } strategies[] = {
+        {MEMKIND_ARENA_SELECT_HASH, "hash"},
+        {MEMKIND_ARENA_SELECT_CPU, "cpu"},
+        {MEMKIND_ARENA_SELECT_ROUND_ROBIN, "round_robin"},
+    };
+
+    ASSERT_EQ(0, memkind_check_available(MEMKIND_REGULAR));
+    for (size_t threadsNum = 1; threadsNum <= 256; threadsNum *= 2) {
+        for (const auto &strategy : strategies) {
+            ostringstream name, ops;
+            name << strategy.name << "_" << threadsNum << "_threads_ops_per_sec";
+            ops << measure(strategy.select, threadsNum);
+            RecordProperty(name.str(), ops.str());
+            cout << name.str() << ": " << ops.str() << endl;
+        }
+    }
+}
+
+// Measures cost of touching memory again after it was freed and purged
+// by the background thread with each purge policy
+class PurgeRefaultPerformanceTest : public testing::Test
+{
+protected:
+    const size_t allocSize = 32 * 1024 * 1024;
+    const size_t iterations = 20;
+
+    void measure(memkind_purge_t purge, long &faults, double &seconds)
+    {
+        struct rusage before, after;
+        double total = 0.0;
+
+        ASSERT_EQ(0, memkind_set_purge(MEMKIND_REGULAR, purge));
+        getrusage(RUSAGE_SELF, &before);
+        for (size_t i = 0; i < iterations; ++i) {
+            void *ptr = memkind_malloc(MEMKIND_REGULAR, allocSize);
+            ASSERT_TRUE(ptr != nullptr);
+            auto begin = std::chrono::steady_clock::now();
+            memset(ptr, 'a', allocSize);
+            auto end = std::chrono::steady_clock::now();
+            total += std::chrono::duration<double>(end - begin).count();
+            memkind_free(MEMKIND_REGULAR, ptr);
+            // let the background thread purge dirty pages
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        getrusage(RUSAGE_SELF, &after);
+        faults = after.ru_minflt - before.ru_minflt;
+        seconds = total;
+    }
+};
+
+TEST_F(PurgeRefaultPerformanceTest, test_TC_MEMKIND_perf_purge_refault)
+{
+    ssize_t dirty_decay_ms = MEMKIND_REGULAR->dirty_decay_ms;
+    ssize_t muzzy_decay_ms = MEMKIND_REGULAR->muzzy_decay_ms;
+    long lazy_faults, forced_faults;
+    double lazy_seconds, forced_seconds;
+
+    ASSERT_EQ(0, memkind_check_available(MEMKIND_REGULAR));
+    ASSERT_EQ(0, memkind_set_decay(MEMKIND_REGULAR, 1, 10000));
+    ASSERT_EQ(0, memkind_set_background_purge(5));
+    measure(MEMKIND_PURGE_LAZY, lazy_faults, lazy_seconds);
+    measure(MEMKIND_PURGE_FORCED, forced_faults, forced_seconds);
+    ASSERT_EQ(0, memkind_set_background_purge(0));
+    ASSERT_EQ(0, memkind_set_purge(MEMKIND_REGULAR, MEMKIND_PURGE_LAZY));
+    ASSERT_EQ(0, memkind_set_decay(MEMKIND_REGULAR, dirty_decay_ms,
+                                   muzzy_decay_ms));
+
+    RecordProperty("lazy_minor_faults", lazy_faults);
+    RecordProperty("forced_minor_faults", forced_faults);
+    cout << "lazy: " << lazy_faults << " faults, " << lazy_seconds << " s" << endl;
+    cout << "forced: " << forced_faults << " faults, " << forced_seconds << " s" << endl;
+    // without MADV_FREE support lazy purge falls back to forced one
+    EXPECT_LE(lazy_faults, forced_faults);
+}
@@ -57,3 +57,38 @@ TEST_F(StaticKindsTest, test_TC_MEMKIND_STATIC_KINDS_INIT_ONCE)
     }
 }
 
+
+/*
+ * Assumption: all static kinds should implement malloc_usable_size and good_size operations
+ * Reason:  containers size their buffers by size classes of the heap manager
+ */
+TEST_F(StaticKindsTest, test_TC_MEMKIND_STATIC_KINDS_USABLE_SIZE)
+{
+    for(size_t i=0; i<(sizeof(static_kinds_list)/sizeof(static_kinds_list[0]));
+        i++) {
+        ASSERT_TRUE(static_kinds_list[i]->ops->malloc_usable_size != NULL) <<
+                static_kinds_list[i]->name << " does not implement malloc_usable_size operation!";
+        ASSERT_TRUE(static_kinds_list[i]->ops->good_size != NULL) <<
+                static_kinds_list[i]->name << " does not implement good_size operation!";
+    }
+}
+
+TEST_F(StaticKindsTest, test_TC_MEMKIND_STATIC_KINDS_GOOD_SIZE)
+{
+    const size_t sizes[] = {1, 100, 1001, 4097, 20000, 1572864};
+    memkind_t kinds[] = {MEMKIND_DEFAULT, MEMKIND_REGULAR};
+
+    for (memkind_t kind : kinds) {
+        EXPECT_EQ(0u, memkind_good_size(kind, 0));
+        EXPECT_EQ(0u, memkind_good_size(kind, SIZE_MAX));
+        for (size_t size : sizes) {
+            size_t good_size = memkind_good_size(kind, size);
+            EXPECT_GE(good_size, size);
+            EXPECT_EQ(good_size, memkind_good_size(kind, good_size));
+            void *ptr = memkind_malloc(kind, size);
+            ASSERT_NE(nullptr, ptr);
+            EXPECT_EQ(good_size, memkind_malloc_usable_size(kind, ptr)) << kind->name;
+            memkind_free(kind, ptr);
+        }
+    }
+}